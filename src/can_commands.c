@@ -139,6 +139,51 @@ int pcan_cmd_set_sja1000_async(struct usb_forwarder *forwarder, u8 mode, void *c
     __PCAN_ONEWAY_SET_SINGLE_ARG_ASYNC(forwarder, SAJ1000, 1, mode, complete_func, context);
 }
 
+int pcan_cmd_set_sja1000_reg(struct usb_forwarder *forwarder, u8 reg, u8 value)
+{
+    u8 args[PCAN_CMD_ARGS_LEN] = {
+        [0] = reg,
+        [1] = value,
+    };
+    pcan_cmd_holder_t cmd_holder = CMD_HOLDER_OF_SET_SAJ1000(args);
+
+    return pcan_oneway_command(forwarder, &cmd_holder);
+}
+
+/*
+ * In single filter mode, ACR0:ACR1 (bits 15 ~ 0) are compared with ID10 ~ ID0 (bits 15 ~ 5) and RTR (bit 4)
+ * of a standard frame, or with ID28 ~ ID13 of an extended one, while ACR2:ACR3 are compared with the 2 data bytes
+ * of the former, or with ID12 ~ ID0 and RTR of the latter. Since one set of registers serves both formats,
+ * a bit is cared about only if both filters care about the bits mapped to it and agree on the value,
+ * that is, ID10 ~ ID0 of the 11-bit filter against ID28 ~ ID18 of the 29-bit one, and nothing else.
+ */
+int pcan_cmd_set_acc_filter(struct usb_forwarder *forwarder, u64 filter_11b, u64 filter_29b, u8 mode)
+{
+    u32 code_11b = (u32)(filter_11b >> 32) & CAN_SFF_MASK;
+    u32 code_29b = ((u32)(filter_29b >> 32) & CAN_EFF_MASK) >> 18;
+    u32 care = ~(u32)filter_11b & (~(u32)filter_29b >> 18) & ~(code_11b ^ code_29b) & CAN_SFF_MASK;
+    u16 acr = (code_11b & care) << 5;
+    u16 amr = ~(care << 5);
+    u8 regs[8] = { acr >> 8, acr & 0xff, 0, 0, amr >> 8, amr & 0xff, 0xff, 0xff }; /* ACR0 ~ ACR3, AMR0 ~ AMR3 */
+    u8 extra_mode = SJA1000_MODE_SINGLE_FILTER
+        | ((forwarder->can.ctrlmode & CAN_CTRLMODE_LISTENONLY) ? SJA1000_MODE_LISTEN_ONLY : 0);
+    int err;
+    int i;
+
+    if ((err = pcan_cmd_set_sja1000_reg(forwarder, SJA1000_REG_MODE, SJA1000_MODE_INIT | extra_mode)) < 0)
+        return err;
+
+    for (i = 0; i < ARRAY_SIZE(regs); ++i)
+    {
+        if ((err = pcan_cmd_set_sja1000_reg(forwarder, SJA1000_REG_ACR0 + i, regs[i])) < 0)
+            return err;
+    }
+
+    dev_notice_v(&forwarder->usb_dev->dev, "acceptance filter: ACR = 0x%04x, AMR = 0x%04x\n", acr, amr);
+
+    return pcan_cmd_set_sja1000_reg(forwarder, SJA1000_REG_MODE, mode | extra_mode);
+}
+
 int pcan_cmd_set_bus(struct usb_forwarder *forwarder, u8 is_on)
 {
     __PCAN_ONEWAY_SET_SINGLE_ARG(forwarder, BUS, 0, !!is_on);
@@ -320,5 +365,8 @@ int pcan_cmd_get_device_id(struct usb_forwarder *forwarder, u32 *device_id)
  * >>> 2023-12-12, Man Hung-Coeng <udc577@126.com>:
  *  01. Rename a field of struct usb_forwarder from pending_cmds to pending_ops
  *      due to its wider use.
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Add pcan_cmd_set_sja1000_reg() and pcan_cmd_set_acc_filter().
  */
 
@@ -50,9 +50,25 @@ int pcan_cmd_set_sja1000_async(struct usb_forwarder *forwarder, u8 mode, void *c
 
 #define SJA1000_MODE_NORMAL         0x00
 #define SJA1000_MODE_INIT           0x01
+#define SJA1000_MODE_LISTEN_ONLY    0x02
+#define SJA1000_MODE_SINGLE_FILTER  0x08 /* one 32-bit acceptance filter instead of two short ones */
 
 #define pcan_init_sja1000(fwd)      pcan_cmd_set_sja1000(fwd, SJA1000_MODE_INIT)
 
+/* Registers of SJA1000 in PeliCAN mode, the acceptance ones are only writable in reset (i.e., INIT) mode. */
+#define SJA1000_REG_MODE            0
+#define SJA1000_REG_ACR0            16
+#define SJA1000_REG_AMR0            20
+
+int pcan_cmd_set_sja1000_reg(struct usb_forwarder *forwarder, u8 reg, u8 value);
+
+/*
+ * Programs the acceptance filter of SJA1000 according to PCANFD_OPT_ACC_FILTER_{11B,29B} values
+ * (see chardev_ioctl.h), and leaves the controller in the specified mode (SJA1000_MODE_{NORMAL,INIT}).
+ * The hardware filter may pass more than the values specify, but never less.
+ */
+int pcan_cmd_set_acc_filter(struct usb_forwarder *forwarder, u64 filter_11b, u64 filter_29b, u8 mode);
+
 #define CMD_HOLDER_OF_SET_BUS(_args, ...)               { .functionality = 3, .number = 2, .args = _args, ##__VA_ARGS__ }
 int pcan_cmd_set_bus(struct usb_forwarder *forwarder, u8 is_on);
 int pcan_cmd_set_bus_async(struct usb_forwarder *forwarder, u8 is_on, void *complete_func, void *context);
@@ -109,5 +125,8 @@ int pcan_cmd_get_device_id(struct usb_forwarder *forwarder, u32 *device_id);
  *  01. Add macro CMD_HOLDER_OF_SET_{BTR0BTR1,BITRATE}().
  *  02. Add function pcan_cmd_set_{btr0btr1,bitrate}[_async]().
  *  03. Change license to GPL-2.0.
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Add pcan_cmd_set_sja1000_reg() and pcan_cmd_set_acc_filter().
  */
 
@@ -12,6 +12,7 @@
 #include "versions.h"
 #include "common.h"
 #include "klogging.h"
+#include "msg_filter.h"
 #include "usb_driver.h"
 
 #ifdef __cplusplus
@@ -32,6 +33,62 @@ static inline u8 get_msgtype_from_canid(u32 can_id)
     return MSGTYPE_STANDARD; /* Might be. */
 }
 
+static int wait_for_rx_msgs(struct file *file, usb_forwarder_t *forwarder, pcan_chardev_reader_t *reader)
+{
+    pcan_chardev_t *dev = &forwarder->char_dev;
+    int err;
+
+    if (file->f_flags & O_NONBLOCK)
+        return (pcan_chardev_rx_pending(dev, reader) > 0) ? 0 : -EAGAIN;
+
+    err = wait_event_interruptible(dev->wait_queue_rd,
+        pcan_chardev_rx_ready(dev, reader) || atomic_read(&forwarder->stage) < PCAN_USB_STAGE_ONE_STARTED);
+
+    if (err)
+        return err;
+
+    if (unlikely(atomic_read(&forwarder->stage) < PCAN_USB_STAGE_ONE_STARTED)) /* Has been plugged out. */
+        return -ENODEV;
+
+    if (unlikely(pcan_chardev_rx_pending(dev, reader) <= 0))
+        return signal_pending(current) ? -ERESTARTSYS/*-EINTR*/ : -EAGAIN;
+
+    return 0;
+}
+
+/*
+ * Replaces filters of the opener with a set having count more ranges of added,
+ * or removes all of them if count is 0.
+ */
+static int add_filters(struct file *file, usb_forwarder_t *forwarder, const pcanfd_msg_filter_t *added, u32 count)
+{
+    pcan_chardev_t *dev = &forwarder->char_dev;
+    pcan_chardev_reader_t *reader = (pcan_chardev_reader_t *)file->private_data;
+    pcan_msg_filter_set_t *old;
+    pcan_msg_filter_set_t *set = NULL;
+    int err = 0;
+
+    if (mutex_lock_interruptible(&reader->lock))
+        return -ERESTARTSYS;
+
+    old = rcu_dereference_protected(dev->rx_filters[reader->slot], lockdep_is_held(&reader->lock));
+    if (count > 0 && IS_ERR(set = pcan_msg_filter_set_create(old, added, count)))
+    {
+        err = PTR_ERR(set);
+        dev_err_v(dev->device, "Failed to add %u filters to %u ones: %d\n", count, old ? old->count : 0, err);
+    }
+    else
+    {
+        rcu_assign_pointer(dev->rx_filters[reader->slot], set); /* Messages already queued are not affected. */
+        if (old)
+            kfree_rcu(old, rcu);
+    }
+
+    mutex_unlock(&reader->lock);
+
+    return err;
+}
+
 #define IOCTL_HANDLE_FUNC(name)                 ioctl_##name
 
 #define DECLARE_IOCTL_HANDLE_FUNC(name)         \
@@ -46,69 +103,66 @@ DECLARE_IOCTL_HANDLE_FUNC(init)
 
 DECLARE_IOCTL_HANDLE_FUNC(write_msg)
 {
-    dev_err_ratelimited_v(forwarder->char_dev.device, "Request not supported yet!\n");
+    pcan_ioctl_wr_msg_t msg;
+    struct can_frame frame = { 0 };
+    int ret;
+
+    if (unlikely(__copy_from_user(&msg, arg, sizeof(msg))))
+        return -EFAULT;
+
+    if (unlikely((msg.type & MSGTYPE_STATUS) || msg.len > CAN_MAX_DLC))
+        return -EINVAL;
 
-    return -EOPNOTSUPP;
+    frame.can_id = (msg.type & MSGTYPE_EXTENDED) ? ((msg.id & CAN_EFF_MASK) | CAN_EFF_FLAG) : (msg.id & CAN_SFF_MASK);
+    if (msg.type & MSGTYPE_RTR)
+        frame.can_id |= CAN_RTR_FLAG;
+    frame.can_dlc = msg.len;
+    memcpy(frame.data, msg.data, sizeof(frame.data));
+
+    ret = pcan_chardev_send_frames(forwarder, &frame, 1, file->f_flags & O_NONBLOCK);
+
+    return (ret < 0) ? ret : 0;
 }
 
 DECLARE_IOCTL_HANDLE_FUNC(read_msg)
 {
     pcan_chardev_t *dev = &forwarder->char_dev;
-    unsigned long lock_flags;
+    pcan_chardev_reader_t *reader = (pcan_chardev_reader_t *)file->private_data;
     pcan_ioctl_rd_msg_t msg;
     int err = 0;
 
-    if (file->f_flags & O_NONBLOCK)
-    {
-        if (atomic_read(&dev->rx_unread_cnt) <= 0)
-            return -EAGAIN;
-    }
-    else
-    {
-        err = wait_event_interruptible(dev->wait_queue_rd,
-            atomic_read(&dev->rx_unread_cnt) > 0 || atomic_read(&forwarder->stage) < PCAN_USB_STAGE_ONE_STARTED);
+    if ((err = wait_for_rx_msgs(file, forwarder, reader)))
+        return err;
 
-        if (err)
-            return err;
+    if ((err = pcan_chardev_lock_reader(reader, file->f_flags & O_NONBLOCK)))
+        return err;
 
-        if (unlikely(atomic_read(&forwarder->stage) < PCAN_USB_STAGE_ONE_STARTED)) /* Has been plugged out. */
-            return -ENODEV;
-
-        if (unlikely(atomic_read(&dev->rx_unread_cnt) <= 0))
-            return signal_pending(current) ? -ERESTARTSYS/*-EINTR*/ : -EAGAIN;
-    }
-
-    spin_lock_irqsave(&dev->lock, lock_flags);
+    if (unlikely(0 == pcan_chardev_fetch_rx_records(dev, reader, 1)))
+        err = -EAGAIN;
+    else
     {
-        int unread_msgs = atomic_read(&dev->rx_unread_cnt);
-        int read_index = pcan_chardev_calc_rx_read_index(atomic_read(&dev->rx_write_idx), unread_msgs);
-        struct can_frame *frame = &dev->rx_msgs[read_index].frame;
-        s64 hardware_timestamp = ktime_to_ns(dev->rx_msgs[read_index].hwtstamp);
-
-        if (unlikely(unread_msgs <= 0))
-            err = -EAGAIN;
-        else
-        {
-            msg.msg.id = frame->can_id;
-            msg.msg.type = get_msgtype_from_canid(msg.msg.id); /* FIXME: Or fetch it from value passed by ioctl_init()? */
-            msg.msg.len = frame->can_dlc;
-            memcpy(&msg.msg.data, frame->data, msg.msg.len);
+        pcan_rx_record_t *rec = &reader->recs[0];
+        s64 hardware_timestamp = pcan_chardev_record_ts_ns(dev, reader, rec, /* realtime = */false,
+            /* from_device = */NULL);
+
+        msg.msg.id = rec->can_id;
+        msg.msg.type = get_msgtype_from_canid(msg.msg.id); /* FIXME: Or fetch it from value passed by ioctl_init()? */
+        msg.msg.len = min_t(u8, rec->can_dlc, CAN_MAX_DLC);
+        memcpy(&msg.msg.data, rec->data, msg.msg.len);
 #if BITS_PER_LONG >= 64
-            msg.time_msecs = hardware_timestamp / 1000000;
-            msg.remainder_usecs = hardware_timestamp / 1000 - msg.time_msecs * 1000;
+        msg.time_msecs = hardware_timestamp / 1000000;
+        msg.remainder_usecs = hardware_timestamp / 1000 - msg.time_msecs * 1000;
 #else /* 64-bit divisions above will cause an error of "__aeabi_ldivmod undefined" on 32-bit ARM platforms. */
-            {
-                u32 remainder_nsecs = do_div(hardware_timestamp, 1000000);
-
-                msg.time_msecs = hardware_timestamp;
-                msg.remainder_usecs = remainder_nsecs / 1000;
-            }
-#endif
+        {
+            u32 remainder_nsecs = do_div(hardware_timestamp, 1000000);
 
-            atomic_dec(&dev->rx_unread_cnt);
+            msg.time_msecs = hardware_timestamp;
+            msg.remainder_usecs = remainder_nsecs / 1000;
         }
+#endif
     }
-    spin_unlock_irqrestore(&dev->lock, lock_flags);
+
+    mutex_unlock(&reader->lock);
 
     return unlikely(err) ? err : (__copy_to_user(arg, &msg, sizeof(msg)) ? -EFAULT : 0);
 }
@@ -128,6 +182,7 @@ DECLARE_IOCTL_HANDLE_FUNC(get_diagnostic_info)
         .base = dev->serial_number,
         .irq_level = dev->device_id,
         .read_count = dev->rx_packets,
+        .write_count = dev->tx_packets,
         /* TODO: Use other fields in future. */
         .open_paths = atomic_read(&dev->open_count),
         .version = { DRIVER_VERSION "-" __VER__ },
@@ -147,7 +202,8 @@ DECLARE_IOCTL_HANDLE_FUNC(get_extra_status)
 {
     pcan_chardev_t *dev = &forwarder->char_dev;
     pcan_ioctl_extra_status_t ext_status = {
-        .pending_reads = atomic_read(&dev->rx_unread_cnt)
+        .pending_reads = pcan_chardev_rx_pending(dev, (pcan_chardev_reader_t *)file->private_data),
+        .pending_writes = atomic_read(&dev->active_tx_urbs),
         /* TODO: Use other fields in future. */
     };
 
@@ -156,9 +212,28 @@ DECLARE_IOCTL_HANDLE_FUNC(get_extra_status)
 
 DECLARE_IOCTL_HANDLE_FUNC(set_filter)
 {
-    dev_err_v(forwarder->char_dev.device, "Request not supported yet!\n");
+    pcan_ioctl_msg_filter_t filter;
+    pcanfd_msg_filter_t range;
+
+    if (NULL == arg)
+        return add_filters(file, forwarder, NULL, 0);
 
-    return -EOPNOTSUPP;
+    if (unlikely(__copy_from_user(&filter, arg, sizeof(filter))))
+    {
+        dev_err_v(forwarder->char_dev.device, "__copy_from_user() failed\n");
+
+        return -EFAULT;
+    }
+
+    range.id_from = filter.from_id;
+    range.id_to = filter.to_id;
+    range.msg_flags = 0;
+    if (filter.msg_type & MSGTYPE_EXTENDED)
+        range.msg_flags |= PCANFD_MSG_EXT;
+    if (filter.msg_type & MSGTYPE_RTR)
+        range.msg_flags |= PCANFD_MSG_RTR;
+
+    return add_filters(file, forwarder, &range, 1);
 }
 
 DECLARE_IOCTL_HANDLE_FUNC(extra_params)
@@ -287,125 +362,388 @@ DECLARE_IOCTL_HANDLE_FUNC(fd_get_init)
     return __copy_to_user(arg, &params, sizeof(params)) ? -EFAULT : 0;
 }
 
+static u32 count_filters(pcan_chardev_t *dev, const pcan_chardev_reader_t *reader)
+{
+    pcan_msg_filter_set_t *filters;
+    u32 count;
+
+    rcu_read_lock();
+    filters = rcu_dereference(dev->rx_filters[reader->slot]);
+    count = filters ? filters->count : 0;
+    rcu_read_unlock();
+
+    return count;
+}
+
 DECLARE_IOCTL_HANDLE_FUNC(fd_get_state)
 {
     pcan_chardev_t *dev = &forwarder->char_dev;
+    pcan_chardev_reader_t *reader = (pcan_chardev_reader_t *)file->private_data;
     pcanfd_ioctl_state_t state = {
         .ver_major = DRV_VER_MAJOR,
         .ver_minor = DRV_VER_MINOR,
         .ver_subminor = DRV_VER_RELEASE,
-        .bus_state = PCANFD_ERROR_ACTIVE, /* TODO: More possibilities in future. */
+        .bus_state = pcan_chardev_bus_state(forwarder),
         .device_id = dev->device_id,
         .open_counter = atomic_read(&dev->open_count),
+        .filters_counter = count_filters(dev, reader),
         .hw_type = PRODUCT_TYPE,
         .channel_number = MINOR(file->f_inode->i_rdev) - DEV_MINOR_BASE,
-        .can_status = 0, /* TODO: More possibilities in future. */
+        .can_status = pcan_chardev_can_status(forwarder),
         .bus_load = 0xffff, /* FIXME: 0xffff means "not given". Maybe give it in future. */
-        .rx_max_msgs = PCAN_CHRDEV_MAX_RX_BUF_COUNT,
-        .rx_pending_msgs = atomic_read(&dev->rx_unread_cnt),
+        .tx_max_msgs = PCAN_USB_MAX_TX_URBS,
+        .tx_pending_msgs = atomic_read(&dev->active_tx_urbs),
+        .rx_max_msgs = dev->rx_buf_count,
+        .rx_pending_msgs = pcan_chardev_rx_pending(dev, reader),
+        .tx_frames_counter = dev->tx_packets,
+        .rx_frames_counter = dev->rx_packets,
     };
 
     return __copy_to_user(arg, &state, sizeof(state)) ? -EFAULT : 0;
 }
 
-DECLARE_IOCTL_HANDLE_FUNC(fd_send_msg)
+DECLARE_IOCTL_HANDLE_FUNC(fd_add_filters)
 {
-    dev_err_ratelimited_v(forwarder->char_dev.device, "Request not supported yet!\n");
+    pcanfd_msg_filters_t __user *filtersp = (pcanfd_msg_filters_t __user *)arg;
+    pcanfd_msg_filter_t *list;
+    u32 count;
+    int err;
 
-    return -EOPNOTSUPP;
-}
+    if (NULL == arg)
+        return add_filters(file, forwarder, NULL, 0);
 
-DECLARE_IOCTL_HANDLE_FUNC(fd_recv_msg)
-{
-    dev_err_ratelimited_v(forwarder->char_dev.device, "Request not supported yet!\n");
+    if (unlikely(__get_user(count, &filtersp->count)))
+    {
+        dev_err_v(forwarder->char_dev.device, "__get_user() failed\n");
 
-    return -EOPNOTSUPP;
-}
+        return -EFAULT;
+    }
 
-DECLARE_IOCTL_HANDLE_FUNC(fd_send_msgs)
-{
-    dev_err_ratelimited_v(forwarder->char_dev.device, "Request not supported yet!\n");
+    if (0 == count)
+        return add_filters(file, forwarder, NULL, 0);
+
+    if (count > PCAN_MSG_FILTERS_MAX)
+        return -ENOSPC;
+
+    list = memdup_user(filtersp->list, sizeof(*list) * count);
+    if (IS_ERR(list))
+        return PTR_ERR(list);
+
+    err = add_filters(file, forwarder, list, count);
+    kfree(list);
 
-    return -EOPNOTSUPP;
+    return err;
 }
 
-DECLARE_IOCTL_HANDLE_FUNC(fd_recv_msgs)
+DECLARE_IOCTL_HANDLE_FUNC(fd_get_filters)
 {
     pcan_chardev_t *dev = &forwarder->char_dev;
-    pcanfd_ioctl_msgs_t *msgp = dev->ioctl_rxmsgs;
-    unsigned long lock_flags;
+    pcan_chardev_reader_t *reader = (pcan_chardev_reader_t *)file->private_data;
+    pcanfd_msg_filters_t __user *filtersp = (pcanfd_msg_filters_t __user *)arg;
+    pcan_msg_filter_set_t *filters;
+    u32 count;
+    u32 total;
     int err = 0;
 
-    if (file->f_flags & O_NONBLOCK)
+    if (unlikely(__get_user(count, &filtersp->count)))
     {
-        if (atomic_read(&dev->rx_unread_cnt) <= 0)
-            return -EAGAIN;
+        dev_err_v(dev->device, "__get_user() failed\n");
+
+        return -EFAULT;
     }
+
+    if (mutex_lock_interruptible(&reader->lock)) /* The only one replacing filters of this opener. */
+        return -ERESTARTSYS;
+
+    filters = rcu_dereference_protected(dev->rx_filters[reader->slot], lockdep_is_held(&reader->lock));
+    total = filters ? filters->count : 0;
+    count = min(count, total);
+    if (count > 0 && copy_to_user(filtersp->list, filters->list, sizeof(filters->list[0]) * count))
+        err = -EFAULT;
+    else if (__put_user(total, &filtersp->count))
+        err = -EFAULT;
+
+    mutex_unlock(&reader->lock);
+
+    return err;
+}
+
+static int fd_msg_to_frame(const pcanfd_ioctl_msg_t *msg, struct can_frame *frame)
+{
+    if (unlikely(PCANFD_TYPE_CAN20_MSG != msg->type || msg->data_len > CAN_MAX_DLC))
+        return -EINVAL;
+
+    memset(frame, 0, sizeof(*frame));
+    if (msg->flags & PCANFD_MSG_EXT)
+        frame->can_id = (msg->id & CAN_EFF_MASK) | CAN_EFF_FLAG;
     else
+        frame->can_id = msg->id & CAN_SFF_MASK;
+    if (msg->flags & PCANFD_MSG_RTR)
+        frame->can_id |= CAN_RTR_FLAG;
+    frame->can_dlc = msg->data_len;
+    memcpy(frame->data, msg->data, sizeof(frame->data));
+
+    return 0;
+}
+
+/* Frames converted on stack and handed over to pcan_chardev_send_frames() at a time. */
+#define TX_CHUNK_FRAMES                         (PCAN_USB_MAX_FRAMES_PER_URB * 2)
+
+/*
+ * Sends at most count messages of the user array list, and returns the count sent,
+ * or a negative error code if nothing sent.
+ */
+static int send_fd_msgs(struct file *file, usb_forwarder_t *forwarder, const pcanfd_ioctl_msg_t __user *list, u32 count)
+{
+    u32 done = 0;
+    int err = 0;
+
+    while (done < count)
     {
-        err = wait_event_interruptible(dev->wait_queue_rd,
-            atomic_read(&dev->rx_unread_cnt) > 0 || atomic_read(&forwarder->stage) < PCAN_USB_STAGE_ONE_STARTED);
+        struct can_frame frames[TX_CHUNK_FRAMES];
+        u32 n = min_t(u32, count - done, TX_CHUNK_FRAMES);
+        u32 valid;
+        int ret;
+
+        for (valid = 0; valid < n; ++valid)
+        {
+            pcanfd_ioctl_msg_t msg;
+
+            /* Only the first 8 bytes of data are needed by CAN 2.0. */
+            if (unlikely(copy_from_user(&msg, list + done + valid, offsetof(pcanfd_ioctl_msg_t, data) + CAN_MAX_DLEN)))
+            {
+                err = -EFAULT;
+                break;
+            }
+
+            if ((err = fd_msg_to_frame(&msg, &frames[valid])))
+                break;
+        }
+
+        if (valid > 0) /* Send the valid ones ahead of an invalid one anyway. */
+        {
+            if ((ret = pcan_chardev_send_frames(forwarder, frames, valid, file->f_flags & O_NONBLOCK)) < 0)
+            {
+                err = ret;
+                break;
+            }
+
+            done += ret;
+            if ((u32)ret < valid)
+                break;
+        }
 
         if (err)
-            return err;
+            break;
+    }
+
+    return done ? (int)done : err;
+}
 
-        if (unlikely(atomic_read(&forwarder->stage) < PCAN_USB_STAGE_ONE_STARTED)) /* Has been plugged out. */
-            return -ENODEV;
+DECLARE_IOCTL_HANDLE_FUNC(fd_send_msg)
+{
+    int ret = send_fd_msgs(file, forwarder, (const pcanfd_ioctl_msg_t __user *)arg, 1);
+
+    return (ret < 0) ? ret : 0;
+}
 
-        if (unlikely(atomic_read(&dev->rx_unread_cnt) <= 0))
-            return signal_pending(current) ? -ERESTARTSYS/*-EINTR*/ : -EAGAIN;
+/* gap: count of messages lost by the opener right before recs[0]. */
+static void fill_fd_msgs(pcan_chardev_t *dev, const pcan_chardev_reader_t *reader, const pcan_rx_record_t *recs,
+    u32 count, pcanfd_ioctl_msg_t *msgs, u32 gap)
+{
+    u32 i;
+
+    for (i = 0; i < count; ++i)
+    {
+        const pcan_rx_record_t *rec = &recs[i];
+        pcanfd_ioctl_msg_t *m = &msgs[i];
+        bool from_device;
+        struct timespec64 tspec = ns_to_timespec64(pcan_chardev_record_ts_ns(dev, reader, rec, /* realtime = */true,
+            &from_device));
+        u32 status;
+
+        memset(m, 0, sizeof(*m)); /* Never leak anything of kernel stack. */
+        m->id = rec->can_id & CAN_EFF_MASK; /* FIXME: It should have been okay even if not using CAN_EFF_MASK. */
+        m->data_len = min_t(u8, rec->can_dlc, CAN_MAX_DLC);
+        memcpy(m->data, rec->data, m->data_len);
+        if (unlikely(pcan_chardev_status_of_record(rec, &status, &m->flags)))
+        {
+            m->type = PCANFD_TYPE_STATUS;
+            m->id = status;
+            m->data_len = 0;
+        }
+        else if (unlikely(rec->can_id & CAN_ERR_FLAG))
+        {
+            m->type = PCANFD_TYPE_ERROR_MSG;
+            m->flags = PCANFD_ERRMSG_RX;
+        }
+        else
+        {
+            m->type = PCANFD_TYPE_CAN20_MSG; /* FIXME: More possibilities in future. */
+            m->flags = get_msgtype_from_canid(rec->can_id);
+        }
+        m->flags |= from_device ? (PCANFD_TIMESTAMP | PCANFD_HWTIMESTAMP) : PCANFD_TIMESTAMP;
+        m->timestamp.tv_sec = tspec.tv_sec;
+        m->timestamp.tv_usec = tspec.tv_nsec / 1000;
+        /* TODO: Error counters and bus load in ctrlr_data. */
     }
 
-    if (unlikely(__get_user(msgp->count, (typeof(msgp->count) *)arg)))
+    if (gap && count)
     {
-        dev_err_v(dev->device, "__get_user() failed\n");
+        u16 ovr_count = min_t(u32, gap, U16_MAX);
 
-        return -EFAULT;
+        msgs[0].flags |= PCANFD_OVRCNT;
+        msgs[0].ctrlr_data[PCANFD_OVRCNT_LSB] = ovr_count & 0xff;
+        msgs[0].ctrlr_data[PCANFD_OVRCNT_MSB] = ovr_count >> 8;
     }
+}
+
+/* Messages converted on stack and copied to user in one go, 384 bytes at most. */
+#define RX_CHUNK_BYTES                          (sizeof(pcanfd_ioctl_msg_t) * 4)
+
+/*
+ * Streams at most max_count unread messages of the reader into the user array list,
+ * fetching PCAN_CHRDEV_MAX_MSGS_PER_READ records at a time, and converting and copying them
+ * in chunks of RX_CHUNK_BYTES, so that the count is only limited by the size of user array.
+ * Returns the count copied (which is 0 only if no message is pending), or a negative error code.
+ */
+static int stream_rx_msgs(struct file *file, usb_forwarder_t *forwarder, void __user *list, u32 max_count, bool is_compact)
+{
+    pcan_chardev_t *dev = &forwarder->char_dev;
+    pcan_chardev_reader_t *reader = (pcan_chardev_reader_t *)file->private_data;
+    size_t msg_size = is_compact ? sizeof(pcanfd_compact_msg_t) : sizeof(pcanfd_ioctl_msg_t);
+    u32 chunk_count = RX_CHUNK_BYTES / msg_size;
+    union
+    {
+        pcanfd_ioctl_msg_t fd[RX_CHUNK_BYTES / sizeof(pcanfd_ioctl_msg_t)];
+        pcanfd_compact_msg_t compact[RX_CHUNK_BYTES / sizeof(pcanfd_compact_msg_t)];
+    } chunk;
+    u32 received = 0;
+    int err = 0;
 
-    if (unlikely(0 == msgp->count))
+    if (unlikely(max_count > INT_MAX / msg_size))
         return -EINVAL;
 
-    spin_lock_irqsave(&dev->lock, lock_flags);
+    if ((err = wait_for_rx_msgs(file, forwarder, reader)))
+        return err;
+
+    if ((err = pcan_chardev_lock_reader(reader, file->f_flags & O_NONBLOCK)))
+        return err;
+
+    while (received < max_count)
     {
-        int unread_msgs = atomic_read(&dev->rx_unread_cnt);
-        int read_index = pcan_chardev_calc_rx_read_index(atomic_read(&dev->rx_write_idx), unread_msgs);
-        typeof(msgp->count) i;
+        u32 fetched = pcan_chardev_fetch_rx_records(dev, reader, max_count - received);
+        u32 i;
 
-        if (unlikely(unread_msgs <= 0))
-            err = -EAGAIN;
-        else
+        if (0 == fetched)
+            break;
+
+        for (i = 0; i < fetched; i += chunk_count)
         {
-            if (msgp->count > (u32)unread_msgs)
-                msgp->count = unread_msgs;
+            u32 n = min(fetched - i, chunk_count);
+            unsigned long left;
+
+            if (is_compact)
+                pcan_chardev_compact_rx_records(dev, reader, &reader->recs[i], n, chunk.compact);
+            else
+                fill_fd_msgs(dev, reader, &reader->recs[i], n, chunk.fd, (0 == i) ? reader->gap : 0);
 
-            for (i = 0; i < msgp->count; ++i)
+            left = copy_to_user((char __user *)list + msg_size * (received + i), &chunk, msg_size * n);
+            if (unlikely(left))
             {
-                pcan_chardev_msg_t *rx_msg = &dev->rx_msgs[read_index];
-                struct can_frame *f = &rx_msg->frame;
-                pcanfd_ioctl_msg_t *m = &msgp->list[i];
-                struct timespec64 tspec = forwarder->bus_up_time;
-
-                m->id = f->can_id & CAN_EFF_MASK; /* FIXME: It should have been okay even if not using CAN_EFF_MASK. */
-                m->data_len = f->can_dlc;
-                memcpy(m->data, f->data, m->data_len);
-                m->type = PCANFD_TYPE_CAN20_MSG; /* FIXME: More possibilities in future. */
-                m->flags = get_msgtype_from_canid(f->can_id); /* FIXME: Also decided by the type above. */
-                m->flags |= PCANFD_TIMESTAMP | PCANFD_HWTIMESTAMP;
-                timespec64_add_ns(&tspec, ktime_to_ns(ktime_sub(rx_msg->hwtstamp, forwarder->time_ref.tv_host_0)));
-                m->timestamp.tv_sec = tspec.tv_sec;
-                m->timestamp.tv_usec = tspec.tv_nsec / 1000;
-                /* TODO: ctrlr_data */
-
-                read_index = (read_index + 1) % PCAN_CHRDEV_MAX_RX_BUF_COUNT;
+                /* The cursor has gone past them all, so report what has been delivered unless nothing. */
+                received += i + (msg_size * n - left) / msg_size;
+                err = received ? 0 : -EFAULT;
+                goto lbl_stream_end;
             }
-
-            atomic_sub(msgp->count, &dev->rx_unread_cnt);
         }
+
+        received += fetched;
+    }
+
+lbl_stream_end:
+
+    mutex_unlock(&reader->lock);
+
+    return unlikely(err) ? err : (int)received;
+}
+
+DECLARE_IOCTL_HANDLE_FUNC(fd_recv_msg)
+{
+    int ret = stream_rx_msgs(file, forwarder, arg, 1, /* is_compact = */false);
+
+    return (ret < 0) ? ret : (ret ? 0 : -EAGAIN);
+}
+
+DECLARE_IOCTL_HANDLE_FUNC(fd_send_msgs)
+{
+    pcanfd_ioctl_msgs_t __user *msgp = (pcanfd_ioctl_msgs_t __user *)arg;
+    u32 count;
+    int ret;
+
+    if (unlikely(__get_user(count, &msgp->count)))
+    {
+        dev_err_v(forwarder->char_dev.device, "__get_user() failed\n");
+
+        return -EFAULT;
     }
-    spin_unlock_irqrestore(&dev->lock, lock_flags);
 
-    return unlikely(err) ? err : (unlikely(copy_to_user(arg, msgp, SIZE_OF_PCANFD_IOCTL_MSGS(msgp->count))) ? -EFAULT : 0);
+    if (unlikely(0 == count))
+        return 0;
+
+    if ((ret = send_fd_msgs(file, forwarder, msgp->list, count)) < 0)
+        return ret;
+
+    return __put_user((u32)ret, &msgp->count) ? -EFAULT : 0; /* count of messages sent actually */
+}
+
+DECLARE_IOCTL_HANDLE_FUNC(fd_recv_msgs)
+{
+    pcanfd_ioctl_msgs_t __user *msgp = (pcanfd_ioctl_msgs_t __user *)arg;
+    u32 count;
+    int ret;
+
+    if (unlikely(__get_user(count, &msgp->count)))
+    {
+        dev_err_v(forwarder->char_dev.device, "__get_user() failed\n");
+
+        return -EFAULT;
+    }
+
+    if (unlikely(0 == count))
+        return -EINVAL;
+
+    if ((ret = stream_rx_msgs(file, forwarder, msgp->list, count, /* is_compact = */false)) <= 0)
+        return ret ? ret : -EAGAIN;
+
+    return __put_user((u32)ret, &msgp->count) ? -EFAULT : 0;
+}
+
+/*
+ * Unlike PCANFD_IOCTL_RECV_MSGS which copies 96 bytes per message (mostly a 64-byte data array
+ * for CAN FD), this one copies only 24 bytes per message, with the timestamp of each message converted
+ * by pcan_chardev_record_ts_ns() according to the timestamp mode of the reader as the other paths do.
+ */
+DECLARE_IOCTL_HANDLE_FUNC(fd_recv_compact_msgs)
+{
+    pcanfd_compact_msgs_t __user *msgp = (pcanfd_compact_msgs_t __user *)arg;
+    u32 count;
+    int ret;
+
+    if (unlikely(__get_user(count, &msgp->count)))
+    {
+        dev_err_v(forwarder->char_dev.device, "__get_user() failed\n");
+
+        return -EFAULT;
+    }
+
+    if (unlikely(0 == count))
+        return -EINVAL;
+
+    if ((ret = stream_rx_msgs(file, forwarder, msgp->list, count, /* is_compact = */true)) <= 0)
+        return ret ? ret : -EAGAIN;
+
+    return __put_user((u32)ret, &msgp->count) ? -EFAULT : 0;
 }
 
 static inline const char* pcanfd_option_name(int index)
@@ -434,6 +772,12 @@ static inline const char* pcanfd_option_name(int index)
         "PCANFD_OPT_LINGER",
         "PCANFD_OPT_SELF_ACK",
         "PCANFD_OPT_BRS_IGNORE",
+        "PCANFD_OPT_DEFERRED_FRM",
+        "PCANFD_OPT_RX_BUF_COUNT",
+        "PCANFD_OPT_RX_READER_STATS",
+        "PCANFD_OPT_READ_MODE",
+        "PCANFD_OPT_RX_DROPS",
+        "PCANFD_OPT_RX_WAKEUP",
     };
 
     return (index >=0 && index < PCANFD_OPT_MAX) ? S_OPT_NAMES[index] : "UNKNOWN_OPTION";
@@ -461,9 +805,103 @@ DECLARE_IOCTL_HANDLE_FUNC(fd_get_option)
         break;
 
     case PCANFD_OPT_HWTIMESTAMP_MODE:
-        u32_val = PCANFD_OPT_HWTIMESTAMP_RAW;
+        u32_val = READ_ONCE(((pcan_chardev_reader_t *)file->private_data)->hwts_mode);
         break;
 
+    case PCANFD_OPT_DRV_CLK_REF:
+        {
+            struct pcan_timeval clk_ref = { 0 };
+            struct timespec64 base;
+            pcan_clock_t clock;
+
+            if (opt.size < (int)sizeof(clk_ref))
+                return -EINVAL;
+
+            /* The anchor of the clock model, which is the base of cooked timestamps, aligned like them. */
+            pcan_time_ref_snapshot(&forwarder->time_ref, &clock);
+            base = ktime_to_timespec64(ktime_mono_to_real(ktime_add(clock.anchor_host, ns_to_ktime(clock.offset_ns))));
+            clk_ref.tv.tv_sec = base.tv_sec;
+            clk_ref.tv.tv_usec = base.tv_nsec / NSEC_PER_USEC;
+            clk_ref.tv_us = pcan_clock_ticks_to_us(clock.anchor_ticks);
+            clk_ref.ts_us = pcan_clock_ticks_to_us(clock.ticks);
+            clk_ref.ts_mode = READ_ONCE(((pcan_chardev_reader_t *)file->private_data)->hwts_mode);
+            clk_ref.clock_drift = clock.freq_ppb;
+
+            return copy_to_user(opt.value, &clk_ref, sizeof(clk_ref)) ? -EFAULT : 0;
+        }
+
+    case PCANFD_OPT_RX_BUF_COUNT:
+        u32_val = dev->rx_buf_count;
+        break;
+
+    case PCANFD_OPT_READ_MODE:
+        u32_val = READ_ONCE(((pcan_chardev_reader_t *)file->private_data)->read_mode);
+        break;
+
+    case PCANFD_OPT_ALLOWED_MSGS:
+        u32_val = READ_ONCE(dev->allowed_msgs[((pcan_chardev_reader_t *)file->private_data)->slot]);
+        break;
+
+    case PCANFD_OPT_RX_READER_STATS:
+        {
+            pcan_chardev_reader_t *reader = (pcan_chardev_reader_t *)file->private_data;
+            pcan_rx_reader_stats_t stats = { 0 };
+
+            if (opt.size < (int)sizeof(stats))
+                return -EINVAL;
+
+            if (mutex_lock_interruptible(&reader->lock))
+                return -ERESTARTSYS;
+            stats.lag = pcan_chardev_rx_pending(dev, reader);
+            stats.max_lag = reader->max_lag;
+            stats.overruns = reader->overruns;
+            stats.lost = reader->lost;
+            mutex_unlock(&reader->lock);
+
+            return copy_to_user(opt.value, &stats, sizeof(stats)) ? -EFAULT : 0;
+        }
+
+    case PCANFD_OPT_ACC_FILTER_11B:
+    case PCANFD_OPT_ACC_FILTER_29B:
+        {
+            u64 filter = (PCANFD_OPT_ACC_FILTER_11B == opt.name)
+                ? READ_ONCE(forwarder->acc_filter_11b) : READ_ONCE(forwarder->acc_filter_29b);
+
+            if (opt.size < (int)sizeof(filter))
+                return -EINVAL;
+
+            return copy_to_user(opt.value, &filter, sizeof(filter)) ? -EFAULT : 0;
+        }
+
+    case PCANFD_OPT_RX_WAKEUP:
+        {
+            const pcan_chardev_rx_wake_t *wake = &dev->rx_wake[((pcan_chardev_reader_t *)file->private_data)->slot];
+            pcan_rx_wakeup_t wakeup = {
+                .frames = READ_ONCE(wake->frames),
+                .usecs = READ_ONCE(wake->usecs),
+            };
+
+            if (opt.size < (int)sizeof(wakeup))
+                return -EINVAL;
+
+            return copy_to_user(opt.value, &wakeup, sizeof(wakeup)) ? -EFAULT : 0;
+        }
+
+    case PCANFD_OPT_RX_DROPS:
+        {
+            pcan_rx_drops_t drops = {
+                .overwritten = atomic64_read(&dev->rx_drops.overwritten),
+                .no_skb = atomic64_read(&dev->rx_drops.no_skb),
+                .dev_overruns = atomic64_read(&dev->rx_drops.dev_overruns),
+                .decode_errors = atomic64_read(&dev->rx_drops.decode_errors),
+            };
+
+            if (opt.size < (int)sizeof(drops))
+                return -EINVAL;
+
+            return copy_to_user(opt.value, &drops, sizeof(drops)) ? -EFAULT : 0;
+        }
+
     default:
         dev_err_v(dev->device, "Not supported!\n");
     }
@@ -472,6 +910,9 @@ DECLARE_IOCTL_HANDLE_FUNC(fd_get_option)
     {
     case PCANFD_OPT_CHANNEL_FEATURES:
     case PCANFD_OPT_HWTIMESTAMP_MODE:
+    case PCANFD_OPT_RX_BUF_COUNT:
+    case PCANFD_OPT_READ_MODE:
+    case PCANFD_OPT_ALLOWED_MSGS:
 #if 0
         return copy_to_user(opt.value, &u32_val, sizeof(u32_val)) ? -EFAULT : 0;
 #else
@@ -497,7 +938,131 @@ DECLARE_IOCTL_HANDLE_FUNC(fd_set_option)
 
     dev_notice_v(dev->device, "name = %d(%s), size = %d\n", opt.name, pcanfd_option_name(opt.name), opt.size);
 
-    dev_warn_ratelimited_v(dev->device, "FIXME: Implement this request in future!\n");
+    switch (opt.name)
+    {
+    case PCANFD_OPT_RX_BUF_COUNT:
+        {
+            pcan_chardev_reader_t *reader = (pcan_chardev_reader_t *)file->private_data;
+            u32 count;
+            int err;
+
+            if (opt.size < (int)sizeof(u32))
+                return -EINVAL;
+
+            if (get_user(count, (u32 *)opt.value))
+                return -EFAULT;
+
+            mutex_lock(&dev->open_lock);
+            if (atomic_read(&dev->open_count) > 1) /* Cursors of other readers would be invalidated. */
+            {
+                dev_err_v(dev->device, "Can not resize Rx buffer while other readers exist.\n");
+                err = -EBUSY;
+            }
+            else
+            {
+                mutex_lock(&reader->lock);
+                if (!(err = pcan_chardev_resize_rx_buf(dev, count)))
+                    WRITE_ONCE(reader->cursor, 0);
+                mutex_unlock(&reader->lock);
+            }
+            mutex_unlock(&dev->open_lock);
+
+            return err;
+        }
+
+    case PCANFD_OPT_ACC_FILTER_11B:
+    case PCANFD_OPT_ACC_FILTER_29B:
+        {
+            u64 filter;
+
+            if (opt.size < (int)sizeof(filter))
+                return -EINVAL;
+
+            if (copy_from_user(&filter, opt.value, sizeof(filter)))
+                return -EFAULT;
+
+            return usbdrv_set_acc_filter(forwarder, /* is_29b = */PCANFD_OPT_ACC_FILTER_29B == opt.name, filter);
+        }
+
+    case PCANFD_OPT_READ_MODE:
+        {
+            pcan_chardev_reader_t *reader = (pcan_chardev_reader_t *)file->private_data;
+            u32 mode;
+
+            if (opt.size < (int)sizeof(u32))
+                return -EINVAL;
+
+            if (get_user(mode, (u32 *)opt.value))
+                return -EFAULT;
+
+            if (mode >= PCANFD_READ_MODE_MAX)
+                return -EINVAL;
+
+            if (mutex_lock_interruptible(&reader->lock)) /* Not to switch in the middle of a read. */
+                return -ERESTARTSYS;
+            WRITE_ONCE(reader->read_mode, mode);
+            mutex_unlock(&reader->lock);
+
+            return 0;
+        }
+
+    case PCANFD_OPT_RX_WAKEUP:
+        {
+            pcan_rx_wakeup_t wakeup;
+
+            if (opt.size < (int)sizeof(wakeup))
+                return -EINVAL;
+
+            if (copy_from_user(&wakeup, opt.value, sizeof(wakeup)))
+                return -EFAULT;
+
+            return pcan_chardev_set_rx_wake(dev, ((pcan_chardev_reader_t *)file->private_data)->slot,
+                wakeup.frames, wakeup.usecs);
+        }
+
+    case PCANFD_OPT_HWTIMESTAMP_MODE:
+        {
+            u32 mode;
+
+            if (opt.size < (int)sizeof(u32))
+                return -EINVAL;
+
+            if (get_user(mode, (u32 *)opt.value))
+                return -EFAULT;
+
+            if (mode >= PCANFD_OPT_HWTIMESTAMP_MAX || PCANFD_OPT_HWTIMESTAMP_RESERVED_4 == mode)
+                return -EINVAL;
+
+            /* Every record carries timestamps of all modes, so it applies to those already received too. */
+            WRITE_ONCE(((pcan_chardev_reader_t *)file->private_data)->hwts_mode, mode);
+
+            return 0;
+        }
+
+    case PCANFD_OPT_ALLOWED_MSGS:
+        {
+            u32 allowed_msgs;
+
+            if (opt.size < (int)sizeof(u32))
+                return -EINVAL;
+
+            if (get_user(allowed_msgs, (u32 *)opt.value))
+                return -EFAULT;
+
+            if (PCANFD_ALLOWED_MSG_ALL != allowed_msgs && (allowed_msgs & ~(PCANFD_ALLOWED_MSG_CAN
+                | PCANFD_ALLOWED_MSG_RTR | PCANFD_ALLOWED_MSG_EXT | PCANFD_ALLOWED_MSG_STATUS | PCANFD_ALLOWED_MSG_ERROR)))
+                return -EINVAL;
+
+            /* Takes effect on messages decoded from now on, those already in Rx ring are still readable. */
+            WRITE_ONCE(dev->allowed_msgs[((pcan_chardev_reader_t *)file->private_data)->slot], allowed_msgs);
+
+            return 0;
+        }
+
+    default:
+        dev_warn_ratelimited_v(dev->device, "FIXME: Implement this request in future!\n");
+        break;
+    }
 
     return 0;
 }
@@ -514,8 +1079,8 @@ const ioctl_handler_t G_FD_IOCTL_HANDLERS[] = {
     { "FD_SET_INIT", IOCTL_HANDLE_FUNC(fd_set_init) },
     { "FD_GET_INIT", IOCTL_HANDLE_FUNC(fd_get_init) },
     { "FD_GET_STATE", IOCTL_HANDLE_FUNC(fd_get_state) },
-    { "FD_ADD_FILTERS", NULL },
-    { "FD_GET_FILTERS", NULL },
+    { "FD_ADD_FILTERS", IOCTL_HANDLE_FUNC(fd_add_filters) },
+    { "FD_GET_FILTERS", IOCTL_HANDLE_FUNC(fd_get_filters) },
     { "FD_SEND_MSG", IOCTL_HANDLE_FUNC(fd_send_msg) },
     { "FD_RECV_MSG", IOCTL_HANDLE_FUNC(fd_recv_msg) },
     { "FD_SEND_MSGS", IOCTL_HANDLE_FUNC(fd_send_msgs) },
@@ -525,6 +1090,7 @@ const ioctl_handler_t G_FD_IOCTL_HANDLERS[] = {
     { "FD_GET_OPTION", IOCTL_HANDLE_FUNC(fd_get_option) },
     { "FD_SET_OPTION", IOCTL_HANDLE_FUNC(fd_set_option) },
     { "FD_RESET", IOCTL_HANDLE_FUNC(fd_reset) },
+    { "FD_RECV_COMPACT_MSGS", IOCTL_HANDLE_FUNC(fd_recv_compact_msgs) },
 };
 
 #ifdef __cplusplus
@@ -545,5 +1111,42 @@ const ioctl_handler_t G_FD_IOCTL_HANDLERS[] = {
  * >>> 2023-12-28, Man Hung-Coeng <udc577@126.com>:
  *  01. Optimize the logic of fetching the counter of unread messages,
  *      which can avoid missing some messages due to the old value of counter.
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Support the option PCANFD_OPT_RX_BUF_COUNT and report the actual
+ *      capacity of Rx buffer in fd_get_state().
+ *  02. Fetch messages from the lock-free Rx ring under the reader mutex
+ *      instead of the spin lock shared with the decoder.
+ *  03. Build messages from binary records of Rx ring, whose wall-clock timestamps
+ *      have been converted by the producer already.
+ *  04. Receive messages through the cursor of each opener, reject resizing Rx buffer
+ *      if more than one opener exist, and add option PCANFD_OPT_RX_READER_STATS.
+ *  05. Support the option PCANFD_OPT_READ_MODE and the request PCANFD_IOCTL_RECV_COMPACT_MSGS.
+ *  06. Implement PCANFD_IOCTL_RECV_MSG, and stream messages of PCANFD_IOCTL_RECV_*MSGS
+ *      to user space in small chunks on stack without any staging buffer and count limit.
+ *  07. Implement PCAN_IOCTL_WRITE_MSG, PCANFD_IOCTL_SEND_MSG and PCANFD_IOCTL_SEND_MSGS,
+ *      and report Tx counters.
+ *  08. Hand over frames of PCANFD_IOCTL_SEND_MSGS in batches big enough to fill Tx URBs.
+ *  09. Add option PCANFD_OPT_RX_DROPS, and mark the first message received after a loss
+ *      with PCANFD_OVRCNT and the count lost.
+ *  10. Implement PCAN_IOCTL_SET_FILTER, PCANFD_IOCTL_ADD_FILTERS and PCANFD_IOCTL_GET_FILTERS
+ *      on per-open filter sets, and report the count of filters in fd_get_state().
+ *  11. Support options PCANFD_OPT_ACC_FILTER_11B and PCANFD_OPT_ACC_FILTER_29B.
+ *  12. Support option PCANFD_OPT_ALLOWED_MSGS per open.
+ *  13. Report the real bus state in fd_get_state(), and convert status records
+ *      into PCANFD_TYPE_STATUS messages.
+ *  14. Add option PCANFD_OPT_RX_WAKEUP, and wait for its thresholds in blocking requests.
+ *  15. Support option PCANFD_OPT_HWTIMESTAMP_MODE per open, and option PCANFD_OPT_DRV_CLK_REF.
+ *  16. Report a consistent snapshot of the clock model as PCANFD_OPT_DRV_CLK_REF.
+ *  17. Pass the chardev to timestamp conversion of records, which takes parameters of their epochs from it.
+ *  18. Apply the calibration offset of the time alignment service to PCANFD_OPT_DRV_CLK_REF.
+ *  19. Set only the requested half of the acceptance filter, the other one left to usbdrv_set_acc_filter().
+ *  20. Set PCANFD_HWTIMESTAMP per message, only if its timestamp is converted from device time.
+ *  21. Return the count of whole messages copied by stream_rx_msgs() if a later chunk faults.
+ *  22. Fill can_status of PCANFD_IOCTL_GET_STATE by pcan_chardev_can_status().
+ *  23. Check option size of PCANFD_OPT_READ_MODE before reading it.
+ *  24. Check option size of PCANFD_OPT_HWTIMESTAMP_MODE before reading it.
+ *  25. Check option size of PCANFD_OPT_ALLOWED_MSGS, and reject unknown bits of it.
+ *  26. Correct the comment of fd_recv_compact_msgs() on timestamp conversion.
  */
 
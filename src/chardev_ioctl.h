@@ -172,7 +172,9 @@ typedef struct pcanfd_ioctl_init {
     struct pcan_bittiming data;
 } pcanfd_ioctl_init_t;
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+#ifndef __KERNEL__
+#include <sys/time.h>
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
 /* struct timeval is deprecated
  * (see https://www.kernel.org/doc/html/latest/core-api/timekeeping.html)
  *
@@ -227,7 +229,7 @@ typedef struct pcanfd_ioctl_state {
     __u16 hw_type;                      /* pcan hareware type, fixed to PRODUCT_TYPE (in common.h) */
     __u16 channel_number;               /* channel number for the device */
 
-    __u16 can_status;                   /* same as wCANStatus but NOT CLEARED */
+    __u16 can_status;                   /* PCANFD_CANSTATUS_*, same as wCANStatus but NOT CLEARED */
     __u16 bus_load;                     /* bus load value, ffff if not given */
 
     __u32 tx_max_msgs;                  /* Tx fifo size in count of msgs */
@@ -243,13 +245,26 @@ typedef struct pcanfd_ioctl_state {
     __u64 hw_time_ns;                   /* when hw_time_ns has been received */
 } pcanfd_ioctl_state_t;
 
+/*
+ * Bits of can_status above and of sysfs attribute status, with the same values as CAN_ERR_* of wCANStatus,
+ * derived from the current bus state, the latest error message of device and counters of driver.
+ */
+#define PCANFD_CANSTATUS_OK             0x0000
+#define PCANFD_CANSTATUS_OVERRUN        0x0002  /* the latest error message tells an Rx overrun of device */
+#define PCANFD_CANSTATUS_BUSLIGHT       0x0004  /* error warning */
+#define PCANFD_CANSTATUS_BUSHEAVY       0x0008  /* error passive */
+#define PCANFD_CANSTATUS_BUSOFF         0x0010
+#define PCANFD_CANSTATUS_QOVERRUN       0x0040  /* Rx ring of driver has been overwritten since initialization */
+#define PCANFD_CANSTATUS_QXMTFULL       0x0080  /* all Tx URBs are in flight */
+
+/* Value of PCANFD_OPT_DRV_CLK_REF, i.e., the time reference the driver converts device timestamps with. */
 struct pcan_timeval
 {
     struct timeval tv;                  /* host base time */
     __u64 tv_us;                        /* hw base time */
     __u64 ts_us;                        /* event hw time */
     __u32 ts_mode;                      /* cooking mode */
-    long clock_drift;                   /* clock drift */
+    long clock_drift;                   /* clock drift, how much faster host clock runs, in ppb */
 };
 
 /* CAN-FD message types */
@@ -301,7 +316,9 @@ enum
     PCANFD_ECHOID = PCANFD_RXERRCNT,    /* PCANFD_MSG_ECHO set */
     PCANFD_TXERRCNT,
     PCANFD_BUSLOAD_UNIT,
+    PCANFD_OVRCNT_LSB = PCANFD_BUSLOAD_UNIT, /* PCANFD_OVRCNT set, never together with PCANFD_BUSLOAD */
     PCANFD_BUSLOAD_DEC,
+    PCANFD_OVRCNT_MSB = PCANFD_BUSLOAD_DEC,
     PCANFD_MAXCTRLRDATALEN
 };
 
@@ -324,6 +341,60 @@ typedef struct pcanfd_ioctl_msgs
 
 #define SIZE_OF_PCANFD_IOCTL_MSGS(count)    (sizeof(pcanfd_ioctl_msgs_t) + sizeof(pcanfd_ioctl_msg_t) * (count))
 
+/*
+ * Compact CAN 2.0 message, used by read() in PCANFD_READ_MODE_COMPACT mode
+ * and by PCANFD_IOCTL_RECV_COMPACT_MSGS, both of which are specific to this driver.
+ *
+ * It takes 24 bytes per frame, against 80 bytes of a text line from read()
+ * and 96 bytes of struct pcanfd_ioctl_msg from PCANFD_IOCTL_RECV_MSGS.
+ */
+typedef struct pcanfd_compact_msg
+{
+    __u32 id;                           /* CAN Id. without any flag */
+    __u16 flags;                        /* PCANFD_MSG_* plus PCANFD_COMPACT_HOST_TS */
+    __u8 dlc;
+    __u8 type;                          /* PCANFD_TYPE_* */
+    __u8 data[8];
+    __u64 ts_ns;                        /* timestamp of CLOCK_REALTIME (see PCANFD_OPT_HWTIMESTAMP_MODE), in ns */
+} pcanfd_compact_msg_t;
+
+/*
+ * Set in flags if ts_ns is host time rather than device time, i.e., in PCANFD_OPT_HWTIMESTAMP_OFF mode,
+ * for events without device time, or if the message is too old for its device time to be converted,
+ * the same as PCANFD_HWTIMESTAMP cleared in struct pcanfd_ioctl_msg.
+ */
+#define PCANFD_COMPACT_HOST_TS          0x8000
+
+typedef struct pcanfd_compact_msgs
+{
+    __u32 count;                        /* [in] capacity of list, [out] count of messages received */
+    __u32 reserved;
+    struct pcanfd_compact_msg list[0];
+} pcanfd_compact_msgs_t;
+
+#define SIZE_OF_PCANFD_COMPACT_MSGS(count)  (sizeof(pcanfd_compact_msgs_t) + sizeof(pcanfd_compact_msg_t) * (count))
+
+/*
+ * Message filter of PCANFD_IOCTL_ADD_FILTERS and PCANFD_IOCTL_GET_FILTERS.
+ * A frame passes if no filter has been added, or its ID is in [id_from, id_to] of any filter
+ * which has PCANFD_MSG_RTR set in msg_flags if it is a remote frame,
+ * and has PCANFD_MSG_EXT set in msg_flags if it is an extended frame.
+ */
+typedef struct pcanfd_msg_filter
+{
+    __u32 id_from;
+    __u32 id_to;
+    __u32 msg_flags;                    /* PCANFD_MSG_* */
+} pcanfd_msg_filter_t;
+
+typedef struct pcanfd_msg_filters
+{
+    __u32 count;                        /* see PCANFD_IOCTL_{ADD,GET}_FILTERS below */
+    struct pcanfd_msg_filter list[0];
+} pcanfd_msg_filters_t;
+
+#define SIZE_OF_PCANFD_MSG_FILTERS(count)   (sizeof(pcanfd_msg_filters_t) + sizeof(pcanfd_msg_filter_t) * (count))
+
 /* PCANFD_OPT_CHANNEL_FEATURES option:
  * features of a channel
  */
@@ -350,6 +421,10 @@ typedef struct pcanfd_ioctl_msgs
  * 5    same as 1 + ts is generated at SOF rather than at EOF (if hw allows it)
  * 6    same as 2 + ts is generated at SOF rather than at EOF (if hw allows it)
  * 7    same as 3 + ts is generated at SOF rather than at EOF (if hw allows it)
+ *
+ * Each open file of this driver starts in mode 2, whose line comes from the clock model of the adapter
+ * against CLOCK_MONOTONIC (the same as skb hwtstamp of netdev), so that timestamps of different adapters
+ * are comparable by default, while mode 1 drifts apart from other adapters by up to 100 us per second.
  */
 enum
 {
@@ -393,9 +468,80 @@ enum
 
     PCANFD_OPT_DEFERRED_FRM,            /* internal use only */
 
+    /* Options below are specific to this driver. */
+    PCANFD_OPT_RX_BUF_COUNT,            /* capacity of chardev Rx buffer (u32, rounded up to a power of 2) */
+    PCANFD_OPT_RX_READER_STATS,         /* statistics of the opener itself (get only, see below) */
+    PCANFD_OPT_READ_MODE,               /* format of data returned by read() of the opener, see below */
+    PCANFD_OPT_RX_DROPS,                /* counts of Rx frames dropped by driver (get only, see below) */
+    PCANFD_OPT_RX_WAKEUP,               /* wakeup moderation of the opener, see below */
+
     PCANFD_OPT_MAX
 };
 
+/* PCANFD_OPT_ACC_FILTER_11B and PCANFD_OPT_ACC_FILTER_29B options:
+ * a 64-bit value with the acceptance code in the upper 32 bits and the mask in the lower 32 bits,
+ * in which bits set to 1 are "don't care". A frame of the corresponding format passes
+ * if its ID equals the code on all the other bits. They apply to all openers and the netdev too.
+ * Setting either of them while bus is on puts the controller into reset mode for a moment, and for the netdev too:
+ * frames arriving meanwhile are lost, frames being transmitted are aborted, and the error state is cleared.
+ */
+#define PCANFD_ACC_FILTER(code, mask)       (((__u64)(code) << 32) | (__u32)(mask))
+#define PCANFD_ACC_FILTER_CODE(value)       ((__u32)((value) >> 32))
+#define PCANFD_ACC_FILTER_MASK(value)       ((__u32)(value))
+#define PCANFD_ACC_11B_OPEN                 PCANFD_ACC_FILTER(0, 0x7ff) /* default: all pass */
+#define PCANFD_ACC_29B_OPEN                 PCANFD_ACC_FILTER(0, 0x1fffffff) /* default: all pass */
+
+/* PCANFD_OPT_RX_READER_STATS option:
+ * each opener reads the shared Rx buffer with its own cursor,
+ * and loses the oldest messages if it falls behind by more than rx_max_msgs
+ */
+typedef struct pcan_rx_reader_stats
+{
+    __u32 lag;                          /* messages waiting to be read by this opener */
+    __u32 max_lag;                      /* the most messages ever waiting */
+    __u32 overruns;                     /* times of being overrun */
+    __u32 reserved;
+    __u64 lost;                         /* messages overwritten before being read */
+} pcan_rx_reader_stats_t;
+
+/* PCANFD_OPT_RX_DROPS option:
+ * counts of Rx frames dropped by reason, since the device was plugged in.
+ * Besides, a message received right after some ones lost by its opener has PCANFD_OVRCNT set,
+ * and the count lost (saturated at 0xffff) in ctrlr_data[PCANFD_OVRCNT_LSB] and ctrlr_data[PCANFD_OVRCNT_MSB].
+ */
+typedef struct pcan_rx_drops
+{
+    __u64 overwritten;                  /* overwritten in Rx buffer before being read, summed over openers */
+    __u64 no_skb;                       /* not passed to netdev due to failure of socket buffer allocation */
+    __u64 dev_overruns;                 /* times of Rx queue overrun reported by device */
+    __u64 decode_errors;                /* times of malformed USB messages, the rest of which are discarded */
+} pcan_rx_drops_t;
+
+/* PCANFD_OPT_RX_WAKEUP option:
+ * like interrupt coalescing of network cards, a blocked read() or poll() of the opener returns
+ * once frames messages are pending, or usecs microseconds after the first of them arrived,
+ * whichever comes first. Status messages are never delayed, nor is a non-blocking read() of pending messages.
+ * The default {1, 0} wakes the opener up on every message. usecs must not be 0 unless frames is 1.
+ */
+typedef struct pcan_rx_wakeup
+{
+    __u32 frames;                       /* 1 to PCAN_CHRDEV_MAX_RX_BUF_COUNT */
+    __u32 usecs;                        /* 0 to 1000000 */
+} pcan_rx_wakeup_t;
+
+/* PCANFD_OPT_READ_MODE option:
+ * PCANFD_READ_MODE_TEXT        one line of text per message (default)
+ * PCANFD_READ_MODE_COMPACT     an array of struct pcanfd_compact_msg,
+ *                              the size of buffer must be a multiple of its size
+ */
+enum
+{
+    PCANFD_READ_MODE_TEXT,
+    PCANFD_READ_MODE_COMPACT,
+
+    PCANFD_READ_MODE_MAX
+};
+
 typedef struct pcanfd_ioctl_option
 {
     int size;
@@ -421,11 +567,16 @@ enum
     PCANFD_SEQ_GET_OPTION,
     PCANFD_SEQ_SET_OPTION,
     PCANFD_SEQ_RESET,
+    PCANFD_SEQ_RECV_COMPACT_MSGS,       /* specific to this driver */
 };
 
 #define PCANFD_IOCTL_SET_INIT           _IOW(PCAN_MAGIC_NUMBER, PCANFD_SEQ_SET_INIT, pcanfd_ioctl_init_t)
 #define PCANFD_IOCTL_GET_INIT           _IOR(PCAN_MAGIC_NUMBER, PCANFD_SEQ_GET_INIT, pcanfd_ioctl_init_t)
 #define PCANFD_IOCTL_GET_STATE          _IOR(PCAN_MAGIC_NUMBER, PCANFD_SEQ_GET_STATE, pcanfd_ioctl_state_t)
+/* Adds count filters of list to the opener, or removes all of them if count is 0 or the argument is NULL. */
+#define PCANFD_IOCTL_ADD_FILTERS        _IOW(PCAN_MAGIC_NUMBER, PCANFD_SEQ_ADD_FILTERS, pcanfd_msg_filters_t)
+/* Copies at most count filters of the opener to list, and sets count to the count of all its filters. */
+#define PCANFD_IOCTL_GET_FILTERS        _IOWR(PCAN_MAGIC_NUMBER, PCANFD_SEQ_GET_FILTERS, pcanfd_msg_filters_t)
 #define PCANFD_IOCTL_SEND_MSG           _IOW(PCAN_MAGIC_NUMBER, PCANFD_SEQ_SEND_MSG, pcanfd_ioctl_msg_t)
 #define PCANFD_IOCTL_RECV_MSG           _IOR(PCAN_MAGIC_NUMBER, PCANFD_SEQ_RECV_MSG, pcanfd_ioctl_msg_t)
 #define PCANFD_IOCTL_SEND_MSGS          _IOWR(PCAN_MAGIC_NUMBER, PCANFD_SEQ_SEND_MSGS, pcanfd_ioctl_msgs_t)
@@ -433,11 +584,14 @@ enum
 #define PCANFD_IOCTL_GET_OPTION         _IOWR(PCAN_MAGIC_NUMBER, PCANFD_SEQ_GET_OPTION, pcanfd_ioctl_option_t)
 #define PCANFD_IOCTL_SET_OPTION         _IOW(PCAN_MAGIC_NUMBER, PCANFD_SEQ_SET_OPTION, pcanfd_ioctl_option_t)
 #define PCANFD_IOCTL_RESET              _IOW(PCAN_MAGIC_NUMBER, PCANFD_SEQ_RESET, unsigned long)
+#define PCANFD_IOCTL_RECV_COMPACT_MSGS  _IOWR(PCAN_MAGIC_NUMBER, PCANFD_SEQ_RECV_COMPACT_MSGS, pcanfd_compact_msgs_t)
 
 /******************************************************************************
  * Definitions for upper layer.
  *****************************************************************************/
 
+#ifdef __KERNEL__
+
 struct file;
 struct usb_forwarder;
 
@@ -450,6 +604,8 @@ typedef struct ioctl_handler
 extern const ioctl_handler_t G_IOCTL_HANDLERS[];
 extern const ioctl_handler_t G_FD_IOCTL_HANDLERS[];
 
+#endif /* #ifdef __KERNEL__ */
+
 #ifdef __cplusplus
 }
 #endif
@@ -466,5 +622,22 @@ extern const ioctl_handler_t G_FD_IOCTL_HANDLERS[];
  *
  * >>> 2023-12-23, Man Hung-Coeng <udc577@126.com>:
  *  01. Add new flags indicating timestamp, error/overrun counts and bus load.
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Add a driver-specific option PCANFD_OPT_RX_BUF_COUNT.
+ *  02. Add a driver-specific option PCANFD_OPT_RX_READER_STATS.
+ *  03. Add a driver-specific option PCANFD_OPT_READ_MODE, a compact message format
+ *      and a request PCANFD_IOCTL_RECV_COMPACT_MSGS using it,
+ *      and hide definitions for upper layer from user space.
+ *  04. Add a driver-specific option PCANFD_OPT_RX_DROPS,
+ *      and define indexes of overrun count in ctrlr_data.
+ *  05. Add message filters, PCANFD_IOCTL_ADD_FILTERS and PCANFD_IOCTL_GET_FILTERS.
+ *  06. Define the value format of PCANFD_OPT_ACC_FILTER_{11B,29B}.
+ *  07. Add a driver-specific option PCANFD_OPT_RX_WAKEUP.
+ *  08. Document struct pcan_timeval as the value of PCANFD_OPT_DRV_CLK_REF.
+ *  09. Document the side effects of setting the acceptance filter while bus is on.
+ *  10. Add flag PCANFD_COMPACT_HOST_TS of compact messages.
+ *  11. Define PCANFD_CANSTATUS_* bits of can_status of struct pcanfd_ioctl_state.
+ *  12. Document PCANFD_OPT_HWTIMESTAMP_COOKED as the default timestamp mode.
  */
 
@@ -9,9 +9,13 @@
 
 #include "chardev_operations.h"
 
+#include <linux/version.h> /* For LINUX_VERSION_CODE. */
 #include <linux/module.h>
 #include <linux/poll.h>
-#include <linux/highmem.h> /* For kmap() series. */
+#include <linux/log2.h> /* For roundup_pow_of_two(). */
+#include <linux/mm.h> /* For remap_vmalloc_range(). */
+#include <linux/vmalloc.h> /* For vmalloc_user() and vfree(). */
+#include <linux/uio.h> /* For struct iov_iter, copy_to_iter(), etc. */
 
 #include "versions.h"
 #include "common.h"
@@ -19,125 +23,1129 @@
 #include "can_commands.h"
 #include "chardev_group.h"
 #include "chardev_ioctl.h"
+#include "msg_filter.h"
 #include "usb_driver.h"
 #include "evol_kernel.h"
 
 #define DEFAULT_TIMEZONE                8
-#define DEFAULT_MAP_UMEM_FLAG           0
 
 static s16 timezone = DEFAULT_TIMEZONE;
 module_param(timezone, short, 0644);
 MODULE_PARM_DESC(timezone, " time zone (default: " __stringify(DEFAULT_TIMEZONE) ")");
 
-static bool map_umem = DEFAULT_MAP_UMEM_FLAG;
-module_param(map_umem, bool, 0644);
-MODULE_PARM_DESC(map_umem, " whether to map user-space memory (default: " __stringify(DEFAULT_MAP_UMEM_FLAG) ")");
+static u32 rx_buf_count = PCAN_CHRDEV_DEFAULT_RX_BUF_COUNT;
+module_param(rx_buf_count, uint, 0644);
+MODULE_PARM_DESC(rx_buf_count, " capacity of Rx buffer of chardev, rounded up to a power of 2"
+    " (default: " __stringify(PCAN_CHRDEV_DEFAULT_RX_BUF_COUNT) ")");
+
+static enum hrtimer_restart rx_wake_timer_callback(struct hrtimer *timer)
+{
+    pcan_chardev_rx_wake_t *wake = container_of(timer, pcan_chardev_rx_wake_t, timer);
+
+    atomic_set(&wake->unwoken, 0);
+    WRITE_ONCE(wake->expired, true);
+    wake_up_interruptible(&wake->dev->wait_queue_rd);
+
+    return HRTIMER_NORESTART;
+}
+
+static void init_rx_wake(pcan_chardev_t *dev, pcan_chardev_rx_wake_t *wake)
+{
+    wake->frames = 1;
+    wake->usecs = 0;
+    atomic_set(&wake->unwoken, 0);
+    wake->expired = false;
+    wake->dev = dev;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 15, 0)
+    hrtimer_setup(&wake->timer, rx_wake_timer_callback, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+#else
+    hrtimer_init(&wake->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    wake->timer.function = rx_wake_timer_callback;
+#endif
+}
 
 int pcan_chardev_initialize(pcan_chardev_t *dev)
 {
     usb_forwarder_t *forwarder = (usb_forwarder_t *)container_of(dev, usb_forwarder_t, char_dev);
+    int i;
+
+    if (IS_ERR(dev->device = CHRDEV_GRP_MAKE_ITEM(DEV_NAME, forwarder)))
+    {
+        int err = PTR_ERR(dev->device);
+
+        pr_err_v("Failed to create chardev: %d\n", err);
+
+        return err;
+    }
+
+    atomic_set(&forwarder->char_dev.open_count, 0);
+    atomic_set(&forwarder->char_dev.active_tx_urbs, 0);
+    atomic64_set(&dev->rx_drops.overwritten, 0);
+    atomic64_set(&dev->rx_drops.no_skb, 0);
+    atomic64_set(&dev->rx_drops.dev_overruns, 0);
+    atomic64_set(&dev->rx_drops.decode_errors, 0);
+
+    mutex_init(&dev->open_lock);
+    RCU_INIT_POINTER(dev->rx_ring, NULL);
+    dev->rx_buf_count = 0;
+    dev->reader_slots = 0;
+    memset(&dev->status_queue, 0, sizeof(dev->status_queue));
+    for (i = 0; i < PCAN_CHRDEV_MAX_READERS; ++i)
+    {
+        init_rx_wake(dev, &dev->rx_wake[i]);
+    }
+
+    init_waitqueue_head(&dev->wait_queue_rd);
+    init_waitqueue_head(&dev->wait_queue_wr);
+
+    return 0;
+}
+
+static void release_rx_ring(struct kref *kref)
+{
+    pcan_chardev_rx_ring_t *ring = container_of(kref, pcan_chardev_rx_ring_t, refs);
+
+    vfree(ring->ctrl);
+    kfree(ring);
+}
+
+static int replace_rx_ring(pcan_chardev_t *dev, pcan_chardev_rx_ring_t *new_ring)
+{
+    pcan_chardev_rx_ring_t *old_ring;
+
+    lockdep_assert_held(&dev->open_lock);
+
+    old_ring = pcan_chardev_lock_rx_ring(dev);
+    if (new_ring && old_ring && kref_read(&old_ring->refs) > 1) /* still mapped into user space */
+        return -EBUSY;
+
+    rcu_assign_pointer(dev->rx_ring, new_ring);
+    if (new_ring)
+        dev->rx_buf_count = new_ring->mask + 1;
+
+    if (old_ring)
+    {
+        synchronize_rcu(); /* wait for the producer to leave the old ring */
+        kref_put(&old_ring->refs, release_rx_ring); /* memory lives on if it's still mapped */
+    }
+
+    return 0;
+}
+
+static inline void free_rx_buf(pcan_chardev_t *dev)
+{
+    replace_rx_ring(dev, NULL);
+}
+
+int pcan_chardev_resize_rx_buf(pcan_chardev_t *dev, u32 count)
+{
+    pcan_chardev_rx_ring_t *ring;
+    size_t records_offset = PAGE_ALIGN(sizeof(pcan_rx_ring_ctrl_t)); /* ts_epochs takes several pages */
+    int err;
+
+    count = roundup_pow_of_two(clamp_t(u32, count, PCAN_CHRDEV_MIN_RX_BUF_COUNT, PCAN_CHRDEV_MAX_RX_BUF_COUNT));
+
+    if (rcu_access_pointer(dev->rx_ring) && count == dev->rx_buf_count)
+        return 0;
+
+    if (NULL == (ring = kzalloc(sizeof(*ring), GFP_KERNEL))) /* next and batch fields zeroed too */
+        return -ENOMEM;
+
+    ring->mem_size = records_offset + PAGE_ALIGN(sizeof(ring->records[0]) * count);
+    if (NULL == (ring->ctrl = vmalloc_user(ring->mem_size))) /* zeroed, and ready for remap_vmalloc_range() */
+    {
+        dev_err_v(dev->device, "vmalloc_user() for %u Rx messages failed\n", count);
+        kfree(ring);
+
+        return -ENOMEM;
+    }
+
+    kref_init(&ring->refs);
+    ring->mask = count - 1;
+    ring->head = 0;
+    ring->records = (pcan_rx_record_t *)((char *)ring->ctrl + records_offset);
+    ring->ctrl->version = PCAN_RX_RING_VERSION;
+    ring->ctrl->record_size = sizeof(ring->records[0]);
+    ring->ctrl->capacity = count;
+    ring->ctrl->records_offset = records_offset;
+
+    memset(dev->last_accepted, 0xff, sizeof(dev->last_accepted)); /* i.e., (0 - 1), nothing accepted yet */
+
+    if ((err = replace_rx_ring(dev, ring)) < 0)
+    {
+        dev_err_v(dev->device, "Can not resize Rx buffer while it is mapped.\n");
+        kref_put(&ring->refs, release_rx_ring);
+
+        return err;
+    }
+
+    dev_notice_v(dev->device, "Rx buffer capacity: %u messages\n", count);
+
+    return 0;
+}
+
+int pcan_chardev_set_rx_wake(pcan_chardev_t *dev, u32 slot, u32 frames, u32 usecs)
+{
+    pcan_chardev_rx_wake_t *wake = &dev->rx_wake[slot];
+
+    if (frames < 1 || frames > PCAN_CHRDEV_MAX_RX_BUF_COUNT || usecs > USEC_PER_SEC || (frames > 1 && 0 == usecs))
+        return -EINVAL;
+
+    WRITE_ONCE(wake->frames, frames);
+    WRITE_ONCE(wake->usecs, usecs);
+    if (0 == usecs)
+        hrtimer_cancel(&wake->timer);
+    WRITE_ONCE(wake->expired, false);
+    atomic_set(&wake->unwoken, 0);
+    wake_up_interruptible(&dev->wait_queue_rd); /* A smaller threshold might have been reached already. */
+
+    return 0;
+}
+
+/*
+ * Counts messages accepted by a slot, and tells whether its reader should be woken up now.
+ * Otherwise, starts the timer if they are the first of a batch.
+ */
+static bool moderate_rx_wake(pcan_chardev_rx_wake_t *wake, u32 count)
+{
+    u32 usecs = READ_ONCE(wake->usecs);
+
+    if ((u32)atomic_add_return(count, &wake->unwoken) >= READ_ONCE(wake->frames))
+    {
+        atomic_set(&wake->unwoken, 0);
+        if (usecs)
+            hrtimer_try_to_cancel(&wake->timer);
+
+        return true;
+    }
+
+    if (usecs && !hrtimer_is_queued(&wake->timer))
+    {
+        WRITE_ONCE(wake->expired, false);
+        hrtimer_start(&wake->timer, ns_to_ktime((u64)usecs * NSEC_PER_USEC), HRTIMER_MODE_REL);
+    }
+
+    return false;
+}
+
+/* Bitmask of slots whose allowed message types and filters accept the frame, called in RCU read-side section. */
+static u8 accepting_readers(pcan_chardev_t *dev, unsigned long slots, canid_t can_id)
+{
+    u8 readers = 0;
+    int slot;
+
+    for_each_set_bit(slot, &slots, PCAN_CHRDEV_MAX_READERS)
+    {
+        const pcan_msg_filter_set_t *filters;
+
+        if (!pcan_msg_is_allowed(READ_ONCE(dev->allowed_msgs[slot]), can_id))
+            continue;
+
+        filters = rcu_dereference(dev->rx_filters[slot]);
+        if (NULL == filters || pcan_msg_filter_set_match(filters, can_id))
+            readers |= BIT(slot);
+    }
+
+    return readers;
+}
+
+/* Written as a sequence lock by decoder only, since it may be reused any time, and read by read_ts_epoch(). */
+static void write_ts_epoch(pcan_rx_ts_epoch_t *entry, const pcan_clock_t *clock)
+{
+    u32 seq = entry->seq + 1;
+
+    WRITE_ONCE(entry->seq, seq); /* odd */
+    smp_wmb();
+
+    entry->epoch = clock->epoch;
+    pcan_clock_to_ts_epoch(clock, entry);
+
+    smp_store_release(&entry->seq, seq + 1);
+}
+
+/*
+ * Makes sure that conversion parameters of the epoch of ts are in place before any record refers to them,
+ * and returns the epoch. Called by decoder only, and the ring is NULL for the status queue.
+ */
+static u32 publish_ts_epoch(pcan_chardev_t *dev, pcan_chardev_rx_ring_t *ring, const pcan_timestamps_t *ts)
+{
+    const pcan_clock_t *clock = ts->clock;
+
+    if (NULL == clock)
+        return 0;
+
+    /* Changed once per window of time references at most, i.e., seldom. */
+    if (unlikely(clock->epoch != dev->ts_epoch))
+    {
+        write_ts_epoch(&dev->ts_epochs[clock->epoch & (PCAN_RX_TS_EPOCHS - 1)], clock);
+        dev->ts_epoch = clock->epoch;
+    }
+
+    if (ring && unlikely(clock->epoch != ring->ts_epoch))
+    {
+        write_ts_epoch(&ring->ctrl->ts_epochs[clock->epoch & (PCAN_RX_TS_EPOCHS - 1)], clock);
+        ring->ts_epoch = clock->epoch;
+    }
+
+    return clock->epoch;
+}
+
+static void write_record(pcan_rx_record_t *rec, u32 index, const struct can_frame *frame, u8 readers,
+    const pcan_timestamps_t *ts, u32 ts_epoch)
+{
+    /* (index - 1) never matches any index mapped to this record, so readers know it's being rewritten. */
+    WRITE_ONCE(rec->seq, index - 1);
+    smp_wmb();
+
+    rec->can_id = frame->can_id;
+    rec->can_dlc = frame->can_dlc;
+    rec->readers = readers;
+    rec->ts_raw = ts->raw;
+    memcpy(rec->data, frame->data, sizeof(rec->data));
+    rec->ts_ticks = ts->ticks;
+    rec->ts_host_ns = ktime_to_ns(ts->host);
+    rec->ts_epoch = ts_epoch;
+
+    smp_store_release(&rec->seq, index);
+}
+
+int pcan_chardev_push_rx_msg(pcan_chardev_t *dev, const struct can_frame *frame, const pcan_timestamps_t *ts)
+{
+    pcan_chardev_rx_ring_t *ring;
+    int err = 0;
+
+    rcu_read_lock();
+
+    ring = rcu_dereference(dev->rx_ring);
+    if (unlikely(NULL == ring))
+        err = -ESHUTDOWN;
+    else
+    {
+        unsigned long slots = READ_ONCE(dev->reader_slots);
+        u32 index = ring->next; /* No one else writes it. */
+        u8 readers = accepting_readers(dev, slots, frame->can_id);
+        int slot;
+
+        ++dev->rx_packets;
+        if (0 == readers) /* Rejected by all. */
+            goto lbl_push_end;
+
+        write_record(pcan_chardev_rx_ring_slot(ring, index), index, frame, readers, ts,
+            publish_ts_epoch(dev, ring, ts));
+        for_each_set_bit(slot, &slots, PCAN_CHRDEV_MAX_READERS)
+        {
+            if (readers & BIT(slot))
+            {
+                ring->batch_last[slot] = index;
+                ++ring->batch_count[slot];
+            }
+        }
+        ring->batch_readers |= readers;
+        ring->next = index + 1;
+    }
+
+lbl_push_end:
+
+    rcu_read_unlock();
+
+    return err;
+}
+
+void pcan_chardev_publish_rx_msgs(pcan_chardev_t *dev)
+{
+    pcan_chardev_rx_ring_t *ring;
+
+    rcu_read_lock();
+
+    ring = rcu_dereference(dev->rx_ring);
+    if (likely(ring) && ring->next != ring->head)
+    {
+        unsigned long batch_readers = ring->batch_readers;
+        bool need_wake = false;
+        int slot;
+
+        for_each_set_bit(slot, &batch_readers, PCAN_CHRDEV_MAX_READERS)
+        {
+            WRITE_ONCE(dev->last_accepted[slot], ring->batch_last[slot]);
+        }
+        smp_store_release(&ring->head, ring->next); /* pairs with pcan_chardev_rx_ring_head() */
+        smp_store_release(&ring->ctrl->head, ring->next);
+
+        for_each_set_bit(slot, &batch_readers, PCAN_CHRDEV_MAX_READERS)
+        {
+            if (moderate_rx_wake(&dev->rx_wake[slot], ring->batch_count[slot]))
+                need_wake = true;
+            ring->batch_count[slot] = 0;
+        }
+        ring->batch_readers = 0;
+
+        if (need_wake)
+            wake_up_interruptible(&dev->wait_queue_rd);
+    }
+
+    rcu_read_unlock();
+}
+
+int pcan_chardev_push_status(pcan_chardev_t *dev, const struct can_frame *frame, const pcan_timestamps_t *ts)
+{
+    pcan_chardev_status_queue_t *queue = &dev->status_queue;
+    unsigned long slots = READ_ONCE(dev->reader_slots);
+    u32 head = queue->head; /* No one else writes it. */
+    u8 readers;
+    int slot;
+
+    if (0 == slots)
+        return -ESHUTDOWN;
+
+    rcu_read_lock();
+    readers = accepting_readers(dev, slots, frame->can_id);
+    rcu_read_unlock();
+
+    if (0 == readers)
+        return 0;
+
+    write_record(&queue->records[head & (PCAN_CHRDEV_STATUS_QUEUE_LEN - 1)], head, frame, readers, ts,
+        publish_ts_epoch(dev, NULL, ts));
+    for_each_set_bit(slot, &slots, PCAN_CHRDEV_MAX_READERS)
+    {
+        if (readers & BIT(slot))
+            WRITE_ONCE(queue->last_accepted[slot], head);
+    }
+    smp_store_release(&queue->head, head + 1); /* pairs with smp_load_acquire() of readers */
+    wake_up_interruptible(&dev->wait_queue_rd); /* Poll tells it from data messages by POLLPRI. */
+
+    return 0;
+}
+
+/* Copies unread status records accepted by the reader into reader->recs, with reader->lock held. */
+static u32 fetch_status_records(pcan_chardev_t *dev, pcan_chardev_reader_t *reader, u32 max_count)
+{
+    pcan_chardev_status_queue_t *queue = &dev->status_queue;
+    u32 head = smp_load_acquire(&queue->head);
+    u32 cursor = reader->status_cursor;
+    u32 copied = 0;
+
+    if (head - cursor > PCAN_CHRDEV_STATUS_QUEUE_LEN) /* Only the latest events are kept. */
+        cursor = head - PCAN_CHRDEV_STATUS_QUEUE_LEN;
+
+    for (; cursor != head && copied < max_count; ++cursor)
+    {
+        pcan_rx_record_t *rec = &queue->records[cursor & (PCAN_CHRDEV_STATUS_QUEUE_LEN - 1)];
+        bool accepted;
+
+        if (smp_load_acquire(&rec->seq) != cursor) /* Overwritten by a newer one, which will be read later. */
+            continue;
+
+        accepted = READ_ONCE(rec->readers) & BIT(reader->slot);
+        if (accepted)
+            memcpy(&reader->recs[copied], rec, sizeof(*rec));
+        smp_rmb();
+
+        if (accepted && READ_ONCE(rec->seq) == cursor)
+            ++copied;
+    }
+
+    WRITE_ONCE(reader->status_cursor, cursor);
+
+    return copied;
+}
+
+/* Accounts records overwritten before the reader could take them, and moves its cursor past them. */
+static void skip_overwritten(pcan_chardev_t *dev, pcan_chardev_reader_t *reader, u32 skipped)
+{
+    reader->lost += skipped;
+    reader->gap = (reader->gap > U32_MAX - skipped) ? U32_MAX : reader->gap + skipped;
+    atomic64_add(skipped, &dev->rx_drops.overwritten);
+    ++reader->overruns;
+    WRITE_ONCE(reader->cursor, reader->cursor + skipped);
+}
+
+u32 pcan_chardev_fetch_rx_records(pcan_chardev_t *dev, pcan_chardev_reader_t *reader, u32 max_count)
+{
+    pcan_chardev_rx_ring_t *ring;
+    pcan_rx_record_t *recs;
+    u32 status_count;
+    u32 copied = 0;
+
+    lockdep_assert_held(&reader->lock);
+
+    max_count = min_t(u32, max_count, ARRAY_SIZE(reader->recs));
+    reader->gap = 0;
+
+    status_count = fetch_status_records(dev, reader, max_count);
+    recs = &reader->recs[status_count];
+    max_count -= status_count;
+
+    rcu_read_lock();
+
+    ring = rcu_dereference(dev->rx_ring);
+    while (ring && max_count > 0)
+    {
+        u32 head = pcan_chardev_rx_ring_head(ring);
+        u32 lag = head - reader->cursor;
+        u32 scanned;
+
+        if (lag > ring->mask + 1) /* Overrun: skip what has been overwritten. */
+        {
+            skip_overwritten(dev, reader, lag - (ring->mask + 1));
+            lag = ring->mask + 1;
+        }
+
+        if (lag > reader->max_lag)
+            reader->max_lag = lag;
+
+        for (scanned = 0, copied = 0; scanned < lag && copied < max_count; ++scanned)
+        {
+            u32 index = reader->cursor + scanned;
+            pcan_rx_record_t *rec = pcan_chardev_rx_ring_slot(ring, index);
+            bool accepted;
+
+            if (smp_load_acquire(&rec->seq) != index)
+                break;
+
+            accepted = READ_ONCE(rec->readers) & BIT(reader->slot);
+            if (accepted)
+                memcpy(&recs[copied], rec, sizeof(*rec));
+            smp_rmb();
+
+            if (READ_ONCE(rec->seq) != index)
+                break;
+
+            if (accepted)
+                ++copied;
+        }
+
+        WRITE_ONCE(reader->cursor, reader->cursor + scanned);
+
+        if (copied > 0 || scanned == lag)
+            break;
+
+        /*
+         * The record at cursor is being overwritten by a batch not published yet, and is lost anyway.
+         * Never wait for the producer to publish it, which may be preempted by this reader on PREEMPT_RT.
+         */
+        if (0 == scanned)
+            skip_overwritten(dev, reader, 1);
+    }
+
+    rcu_read_unlock();
+
+    return status_count + copied;
+}
+
+bool pcan_chardev_status_of_record(const pcan_rx_record_t *rec, u32 *status, u32 *flags)
+{
+    if (!pcan_msg_is_status(rec->can_id))
+        return false;
+
+    *flags = PCANFD_ERROR_BUS;
+    if (rec->can_id & CAN_ERR_BUSOFF)
+        *status = PCANFD_ERROR_BUSOFF;
+    else if (rec->data[1] & (CAN_ERR_CRTL_RX_PASSIVE | CAN_ERR_CRTL_TX_PASSIVE))
+        *status = PCANFD_ERROR_PASSIVE;
+    else if (rec->data[1] & (CAN_ERR_CRTL_RX_WARNING | CAN_ERR_CRTL_TX_WARNING))
+        *status = PCANFD_ERROR_WARNING;
+    else if (rec->data[1] & (CAN_ERR_CRTL_RX_OVERFLOW | CAN_ERR_CRTL_TX_OVERFLOW))
+    {
+        *status = (rec->data[1] & CAN_ERR_CRTL_RX_OVERFLOW) ? PCANFD_RX_OVERFLOW : PCANFD_TX_OVERFLOW;
+        *flags = PCANFD_ERROR_CTRLR;
+    }
+    else
+        *status = PCANFD_ERROR_ACTIVE; /* CAN_ERR_RESTARTED, etc. */
+
+    return true;
+}
+
+u32 pcan_chardev_bus_state(const usb_forwarder_t *forwarder)
+{
+    switch (READ_ONCE(forwarder->can.state))
+    {
+    case CAN_STATE_ERROR_ACTIVE:
+        return PCANFD_ERROR_ACTIVE;
+
+    case CAN_STATE_ERROR_WARNING:
+        return PCANFD_ERROR_WARNING;
+
+    case CAN_STATE_ERROR_PASSIVE:
+        return PCANFD_ERROR_PASSIVE;
+
+    case CAN_STATE_BUS_OFF:
+        return PCANFD_ERROR_BUSOFF;
+
+    default:
+        return PCANFD_UNKNOWN;
+    }
+}
+
+u16 pcan_chardev_can_status(const usb_forwarder_t *forwarder)
+{
+    const pcan_chardev_t *dev = &forwarder->char_dev;
+    u16 status = READ_ONCE(dev->dev_overrun) ? PCANFD_CANSTATUS_OVERRUN : PCANFD_CANSTATUS_OK;
+
+    switch (READ_ONCE(forwarder->can.state))
+    {
+    case CAN_STATE_ERROR_WARNING:
+        status |= PCANFD_CANSTATUS_BUSLIGHT;
+        break;
+
+    case CAN_STATE_ERROR_PASSIVE:
+        status |= PCANFD_CANSTATUS_BUSHEAVY;
+        break;
+
+    case CAN_STATE_BUS_OFF:
+        status |= PCANFD_CANSTATUS_BUSOFF;
+        break;
+
+    default:
+        break;
+    }
+
+    if (atomic64_read(&dev->rx_drops.overwritten))
+        status |= PCANFD_CANSTATUS_QOVERRUN;
+
+    if (atomic_read(&dev->active_tx_urbs) >= PCAN_USB_MAX_TX_URBS)
+        status |= PCANFD_CANSTATUS_QXMTFULL;
+
+    return status;
+}
+
+/* Copies a consistent entry, whose writer never sleeps in the middle. */
+static void read_ts_epoch(const pcan_rx_ts_epoch_t *entry, pcan_rx_ts_epoch_t *params)
+{
+    u32 seq;
+
+    do
+    {
+        seq = smp_load_acquire(&entry->seq);
+        memcpy(params, entry, sizeof(*params));
+        smp_rmb();
+    } while ((seq & 1) || READ_ONCE(entry->seq) != seq);
+}
+
+u64 pcan_chardev_record_ts_ns(pcan_chardev_t *dev, const pcan_chardev_reader_t *reader, const pcan_rx_record_t *rec,
+    bool realtime, bool *from_device)
+{
+    u32 mode = READ_ONCE(reader->hwts_mode) & 0x3; /* SOF ones taken as their EOF counterparts */
+    pcan_rx_ts_epoch_t params;
+    bool converted = false;
+    ktime_t ts;
+
+    if (PCANFD_OPT_HWTIMESTAMP_RAW == mode)
+    {
+        if (from_device)
+            *from_device = true;
+
+        return pcan_clock_ticks_to_us(rec->ts_ticks) * NSEC_PER_USEC;
+    }
+
+    if (PCANFD_OPT_HWTIMESTAMP_OFF != mode && rec->ts_epoch) /* 0 for events without device time */
+    {
+        read_ts_epoch(&dev->ts_epochs[rec->ts_epoch & (PCAN_RX_TS_EPOCHS - 1)], &params);
+        converted = (params.epoch == rec->ts_epoch); /* or reused by a newer epoch, and no other one fits */
+    }
+
+    if (!converted)
+        ts = ns_to_ktime(rec->ts_host_ns);
+    else if (PCANFD_OPT_HWTIMESTAMP_COOKED == mode)
+    {
+        ts = pcan_ticks_to_host_time(ns_to_ktime(params.cooked_host_ns), params.cooked_ticks,
+            params.cooked_ns_per_tick_q32, rec->ts_ticks);
+    }
+    else
+    {
+        ts = pcan_ticks_to_host_time(ns_to_ktime(params.hw_host_ns), params.hw_ticks,
+            params.hw_ns_per_tick_q32, rec->ts_ticks);
+    }
+
+    if (from_device)
+        *from_device = converted;
+
+    return ktime_to_ns(realtime ? ktime_mono_to_real(ts) : ts);
+}
+
+void pcan_chardev_compact_rx_records(pcan_chardev_t *dev, const pcan_chardev_reader_t *reader,
+    const pcan_rx_record_t *recs, u32 count, pcanfd_compact_msg_t *msgs)
+{
+    u32 i;
+
+    for (i = 0; i < count; ++i)
+    {
+        const pcan_rx_record_t *rec = &recs[i];
+        pcanfd_compact_msg_t *m = &msgs[i];
+        u16 flags = (rec->can_id & CAN_RTR_FLAG) ? PCANFD_MSG_RTR : PCANFD_MSG_STD;
+        u32 status, status_flags;
+        bool from_device;
+
+        if (rec->can_id & CAN_EFF_FLAG)
+            flags |= PCANFD_MSG_EXT;
+
+        m->id = rec->can_id & CAN_EFF_MASK;
+        if (unlikely(pcan_chardev_status_of_record(rec, &status, &status_flags)))
+        {
+            m->type = PCANFD_TYPE_STATUS;
+            m->id = status;
+            flags = status_flags;
+        }
+        else if (unlikely(rec->can_id & CAN_ERR_FLAG))
+        {
+            m->type = PCANFD_TYPE_ERROR_MSG;
+            flags = PCANFD_ERRMSG_RX;
+        }
+        else
+            m->type = PCANFD_TYPE_CAN20_MSG; /* FIXME: More possibilities in future. */
+
+        m->dlc = min_t(u8, rec->can_dlc, CAN_MAX_DLC);
+        memcpy(m->data, rec->data, sizeof(m->data));
+        m->ts_ns = pcan_chardev_record_ts_ns(dev, reader, rec, /* realtime = */true, &from_device);
+        m->flags = from_device ? flags : (flags | PCANFD_COMPACT_HOST_TS);
+    }
+}
+
+#ifdef INNER_TEST
+
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/delay.h>
+#include <linux/timex.h> /* For get_cycles(). */
+#include <linux/math64.h> /* For div_u64(). */
+
+#define RX_RING_SELFTEST_MSGS               1000000
+#define RX_RING_SELFTEST_CONSUMERS          2
+
+typedef struct rx_ring_selftest_consumer
+{
+    struct rx_ring_selftest *test;
+    pcan_chardev_reader_t reader;
+    u64 received;
+    u32 torn;
+    u32 disordered;
+    bool is_slow;
+} rx_ring_selftest_consumer_t;
+
+typedef struct rx_ring_selftest
+{
+    pcan_chardev_t dev;
+    struct completion producer_done;
+    struct completion consumers_done;
+    atomic_t producer_finished;
+    atomic_t running_consumers;
+    rx_ring_selftest_consumer_t consumers[RX_RING_SELFTEST_CONSUMERS];
+} rx_ring_selftest_t;
+
+/* Messages pushed before each publishing by producer of the test, like a URB carrying several records. */
+#define RX_RING_SELFTEST_BATCH              5
+
+static int rx_ring_selftest_producer(void *data)
+{
+    rx_ring_selftest_t *test = (rx_ring_selftest_t *)data;
+    struct can_frame frame = { .can_dlc = sizeof(u32) };
+    pcan_timestamps_t timestamps = { 0 };
+    cycles_t cycles = get_cycles();
+    u32 seq;
+
+    for (seq = 0; seq < RX_RING_SELFTEST_MSGS; ++seq)
+    {
+        frame.can_id = (seq & CAN_EFF_MASK) | CAN_EFF_FLAG;
+        memcpy(frame.data, &seq, sizeof(seq));
+
+        timestamps.ticks = seq;
+        timestamps.raw = seq;
+        pcan_chardev_push_rx_msg(&test->dev, &frame, &timestamps);
+        if (RX_RING_SELFTEST_BATCH - 1 == seq % RX_RING_SELFTEST_BATCH)
+            pcan_chardev_publish_rx_msgs(&test->dev);
+
+        if (!(seq & 0xff))
+            cond_resched();
+    }
+    pcan_chardev_publish_rx_msgs(&test->dev);
+    cycles = get_cycles() - cycles;
+
+    pr_notice_v("Rx ring self-test: producer took %llu cycles per message in batches of %u\n",
+        div_u64(cycles, RX_RING_SELFTEST_MSGS), RX_RING_SELFTEST_BATCH);
+
+    atomic_set(&test->producer_finished, 1);
+    wake_up_interruptible_all(&test->dev.wait_queue_rd);
+    complete(&test->producer_done);
+
+    return 0;
+}
+
+static int rx_ring_selftest_consumer(void *data)
+{
+    rx_ring_selftest_consumer_t *consumer = (rx_ring_selftest_consumer_t *)data;
+    rx_ring_selftest_t *test = consumer->test;
+    pcan_chardev_t *dev = &test->dev;
+    pcan_chardev_reader_t *reader = &consumer->reader;
+    s64 last_seq = -1;
+
+    while (true)
+    {
+        u32 count;
+        u32 j;
+
+        wait_event_interruptible_timeout(dev->wait_queue_rd,
+            pcan_chardev_rx_pending(dev, reader) > 0 || atomic_read(&test->producer_finished), HZ);
+
+        mutex_lock(&reader->lock);
+
+        count = pcan_chardev_fetch_rx_records(dev, reader, ARRAY_SIZE(reader->recs));
+        for (j = 0; j < count; ++j)
+        {
+            pcan_rx_record_t *rec = &reader->recs[j];
+            u32 seq;
+
+            memcpy(&seq, rec->data, sizeof(seq));
+            if (rec->seq != seq || (rec->can_id & CAN_EFF_MASK) != (seq & CAN_EFF_MASK)
+                || rec->ts_raw != seq || rec->ts_ticks != seq)
+                ++consumer->torn;
+            else if ((s64)seq <= last_seq)
+                ++consumer->disordered;
+            last_seq = seq;
+        }
+        consumer->received += count;
+
+        mutex_unlock(&reader->lock);
+
+        if (consumer->is_slow)
+            usleep_range(50, 100); /* Being overrun must not disturb the others. */
+
+        if (0 == count && atomic_read(&test->producer_finished) && 0 == pcan_chardev_rx_pending(dev, reader))
+            break;
+    }
+
+    if (atomic_dec_and_test(&test->running_consumers))
+        complete(&test->consumers_done);
+
+    return 0;
+}
+
+int pcan_chardev_rx_ring_selftest(void)
+{
+    rx_ring_selftest_t *test = kvzalloc(sizeof(*test), GFP_KERNEL);
+    struct task_struct *task;
+    int err = test ? 0 : -ENOMEM;
+    int i;
+
+    if (err)
+        return err;
+
+    mutex_init(&test->dev.open_lock);
+    init_waitqueue_head(&test->dev.wait_queue_rd);
+    init_completion(&test->producer_done);
+    init_completion(&test->consumers_done);
+
+    /* The smallest ring makes wrapping and overrun happen as often as possible. */
+    mutex_lock(&test->dev.open_lock);
+    err = pcan_chardev_resize_rx_buf(&test->dev, PCAN_CHRDEV_MIN_RX_BUF_COUNT);
+    mutex_unlock(&test->dev.open_lock);
+    if (err < 0)
+        goto lbl_test_end;
+
+    for (i = 0; i < RX_RING_SELFTEST_CONSUMERS && !err; ++i)
+    {
+        rx_ring_selftest_consumer_t *consumer = &test->consumers[i];
+
+        consumer->test = test;
+        consumer->is_slow = (i > 0);
+        mutex_init(&consumer->reader.lock);
+        consumer->reader.slot = i;
+        test->dev.allowed_msgs[i] = PCANFD_ALLOWED_MSG_ALL;
+        test->dev.rx_wake[i].frames = 1;
+        set_bit(i, &test->dev.reader_slots);
+        atomic_inc(&test->running_consumers);
+        task = kthread_run(rx_ring_selftest_consumer, consumer, "pcan_rxtest_c%d", i);
+        if (IS_ERR(task))
+        {
+            atomic_dec(&test->running_consumers);
+            err = PTR_ERR(task);
+            pr_err_v("kthread_run() for consumer %d failed: %d\n", i, err);
+        }
+    }
 
-    if (IS_ERR(dev->device = CHRDEV_GRP_MAKE_ITEM(DEV_NAME, forwarder)))
+    task = err ? NULL : kthread_run(rx_ring_selftest_producer, test, "pcan_rxtest_p");
+    if (IS_ERR(task))
     {
-        int err = PTR_ERR(dev->device);
+        err = PTR_ERR(task);
+        pr_err_v("kthread_run() for producer failed: %d\n", err);
+    }
 
-        pr_err_v("Failed to create chardev: %d\n", err);
+    if (err)
+    {
+        atomic_set(&test->producer_finished, 1); /* let the started consumers quit */
+        wake_up_interruptible_all(&test->dev.wait_queue_rd);
+    }
+    else
+        wait_for_completion(&test->producer_done);
 
-        return err;
+    if (atomic_read(&test->running_consumers) > 0)
+        wait_for_completion(&test->consumers_done);
+
+    for (i = 0; i < RX_RING_SELFTEST_CONSUMERS && !err; ++i)
+    {
+        rx_ring_selftest_consumer_t *consumer = &test->consumers[i];
+        bool passed = (RX_RING_SELFTEST_MSGS == consumer->received + consumer->reader.lost
+            && 0 == consumer->torn && 0 == consumer->disordered);
+
+        pr_notice_v("Rx ring self-test of %s consumer %d %s: received = %llu, lost = %llu (%u overruns),"
+            " torn = %u, disordered = %u\n", (consumer->is_slow ? "slow" : "fast"), i, (passed ? "passed" : "FAILED"),
+            consumer->received, consumer->reader.lost, consumer->reader.overruns, consumer->torn, consumer->disordered);
+
+        if (!passed)
+            err = -EPROTO;
     }
 
-    atomic_set(&forwarder->char_dev.open_count, 0);
+    mutex_lock(&test->dev.open_lock);
+    free_rx_buf(&test->dev);
+    mutex_unlock(&test->dev.open_lock);
 
-    spin_lock_init(&dev->lock);
+lbl_test_end:
 
-    init_waitqueue_head(&dev->wait_queue_rd);
-    init_waitqueue_head(&dev->wait_queue_wr);
-    dev->rd_user_buf = NULL;
-    if (map_umem)
-        dev->rd_mapped_addr = NULL;
-    else
+    kvfree(test);
+
+    return err;
+}
+
+#endif /* #ifdef INNER_TEST */
+
+void pcan_chardev_finalize(pcan_chardev_t *dev)
+{
+    int i;
+
+    mutex_lock(&dev->open_lock);
+    free_rx_buf(dev);
+    mutex_unlock(&dev->open_lock);
+
+    for (i = 0; i < PCAN_CHRDEV_MAX_READERS; ++i)
     {
-        dev->rd_kernel_buf = kmalloc(PCAN_CHRDEV_MAX_BYTES_PER_READ * PCAN_CHRDEV_MAX_RX_BUF_COUNT + 1, GFP_KERNEL);
-        if (NULL == dev->rd_kernel_buf)
-        {
-            CHRDEV_GRP_UNMAKE_ITEM(dev->device, NULL);
+        hrtimer_cancel(&dev->rx_wake[i].timer);
+    }
 
-            return -ENOMEM;
-        }
+    CHRDEV_GRP_UNMAKE_ITEM(dev->device, NULL);
+}
+
+static void usb_write_bulk_callback(struct urb *urb)
+{
+    pcan_tx_urb_context_t *ctx = (pcan_tx_urb_context_t *)urb->context;
+    usb_forwarder_t *forwarder = ctx ? ctx->forwarder : NULL;
+    pcan_chardev_t *dev;
+
+    if (NULL == ctx)
+        return;
+
+    dev = &forwarder->char_dev;
+
+    switch (urb->status)
+    {
+    case 0:
+        atomic_inc(&forwarder->shared_tx_counter);
+        dev->tx_packets += ctx->frame_count;
+        break;
+
+    case -EPROTO:
+    case -ENOENT:
+    case -ECONNRESET:
+    case -ESHUTDOWN:
+    case -ENODEV:
+        break;
+
+    default:
+        dev_err_ratelimited_v(dev->device, "Tx urb aborted (%d)\n", urb->status);
+        break;
     }
 
-    return 0;
+    ctx->frame_count = 0;
+    smp_store_release(&ctx->echo_index, 0); /* Give the context back before anyone gets woken up. */
+    atomic_dec(&dev->active_tx_urbs);
+    wake_up_interruptible(&dev->wait_queue_wr);
 }
 
-static void unmap_user_readbuf_if_needed(pcan_chardev_t *dev)
+/* The second half of tx_contexts is reserved for chardev, and echo_index != 0 means in use. */
+static pcan_tx_urb_context_t* claim_tx_context(usb_forwarder_t *forwarder)
 {
-    if (map_umem && dev->rd_mapped_addr)
+    int i;
+
+    for (i = PCAN_USB_MAX_TX_URBS; i < PCAN_USB_MAX_TX_URBS * 2; ++i)
     {
-        struct page *user_page = kmap_to_page(dev->rd_mapped_addr);
+        pcan_tx_urb_context_t *ctx = &forwarder->tx_contexts[i];
 
-        kunmap(user_page);
-        put_page(user_page);
-        dev->rd_mapped_addr = NULL;
+        if (0 == READ_ONCE(ctx->echo_index) && 0 == cmpxchg(&ctx->echo_index, 0, i + 1))
+            return ctx;
     }
-    dev->rd_user_buf = NULL;
+
+    return NULL;
 }
 
-void pcan_chardev_finalize(pcan_chardev_t *dev)
+static bool has_free_tx_context(usb_forwarder_t *forwarder)
 {
-    unmap_user_readbuf_if_needed(dev);
-    if (!map_umem && NULL != dev->rd_kernel_buf)
+    int i;
+
+    for (i = PCAN_USB_MAX_TX_URBS; i < PCAN_USB_MAX_TX_URBS * 2; ++i)
     {
-        kfree(dev->rd_kernel_buf);
-        dev->rd_kernel_buf = NULL;
+        if (0 == READ_ONCE(forwarder->tx_contexts[i].echo_index))
+            return true;
     }
 
-    CHRDEV_GRP_UNMAKE_ITEM(dev->device, NULL);
+    return false;
 }
 
-static void usb_write_bulk_callback(struct urb *urb)
+int pcan_chardev_send_frames(usb_forwarder_t *forwarder, const struct can_frame *frames, u32 count, bool nonblock)
 {
-    /* TODO */
+    pcan_chardev_t *dev = &forwarder->char_dev;
+    u32 sent = 0;
+    int err = 0;
+
+    if (forwarder->can.ctrlmode & CAN_CTRLMODE_LISTENONLY)
+    {
+        dev_err_ratelimited_v(dev->device, "Device in listen-only mode, nothing can be sent!\n");
+
+        return -EPERM;
+    }
+
+    while (sent < count)
+    {
+        pcan_tx_urb_context_t *ctx;
+        struct urb *urb;
+        u32 packed;
+
+        if (unlikely(atomic_read(&forwarder->stage) < PCAN_USB_STAGE_ONE_STARTED)) /* Has been plugged out. */
+        {
+            err = -ENODEV;
+            break;
+        }
+
+        if (unlikely(frames[sent].can_dlc > CAN_MAX_DLC || (frames[sent].can_id & CAN_ERR_FLAG)))
+        {
+            err = -EINVAL;
+            break;
+        }
+
+        if (NULL == (ctx = claim_tx_context(forwarder)))
+        {
+            if (nonblock)
+            {
+                err = -EAGAIN;
+                break;
+            }
+
+            err = wait_event_interruptible(dev->wait_queue_wr,
+                has_free_tx_context(forwarder) || atomic_read(&forwarder->stage) < PCAN_USB_STAGE_ONE_STARTED);
+            if (err)
+                break;
+
+            continue;
+        }
+
+        urb = ctx->urb;
+        pcan_encode_tx_begin(urb->transfer_buffer, &ctx->buf_len);
+        for (packed = 0; sent + packed < count; ++packed) /* Pack as many frames as possible into this URB. */
+        {
+            const struct can_frame *frame = &frames[sent + packed];
+
+            if (packed > 0 && unlikely(frame->can_dlc > CAN_MAX_DLC || (frame->can_id & CAN_ERR_FLAG)))
+                break; /* Leave it to next round, which fails on it if nothing sent before. */
+
+            if (pcan_encode_frame_to_buf(frame, urb->transfer_buffer, &ctx->buf_len))
+                break;
+        }
+        pcan_encode_tx_end(forwarder->net_dev, urb->transfer_buffer);
+        ctx->frame_count = packed;
+
+        atomic_inc(&dev->active_tx_urbs);
+        usb_anchor_urb(urb, &forwarder->anchor_tx_submitted);
+
+        if (unlikely(err = usb_submit_urb(urb, GFP_KERNEL)))
+        {
+            usb_unanchor_urb(urb);
+            ctx->frame_count = 0;
+            smp_store_release(&ctx->echo_index, 0);
+            atomic_dec(&dev->active_tx_urbs);
+            if (-ENODEV != err && -ENOENT != err)
+                dev_err_ratelimited_v(dev->device, "Tx urb submitting failed: %d\n", err);
+            break;
+        }
+
+        sent += packed;
+    }
+
+    return sent ? (int)sent : err;
 }
 
-static int pcan_chardev_open(struct inode *inode, struct file *file)
+static int compact_msg_to_frame(const pcanfd_compact_msg_t *msg, struct can_frame *frame)
 {
-    usb_forwarder_t *forwarder = (usb_forwarder_t *)CHRDEV_GRP_FIND_ITEM_PRIVDATA_BY_INODE(inode);
-    int open_count = forwarder ? atomic_inc_return(&forwarder->char_dev.open_count) : 2;
-    u16 dev_revision = forwarder ? (le16_to_cpu(forwarder->usb_dev->descriptor.bcdDevice) >> 8) : 0;
-    s16 stage = PCAN_USB_STAGE_DISCONNECTED;
-    int err = forwarder ? 0 : -ENODEV;
-    int i;
+    if (unlikely(PCANFD_TYPE_CAN20_MSG != msg->type || msg->dlc > CAN_MAX_DLC))
+        return -EINVAL;
 
-    if (err)
-        return err;
+    memset(frame, 0, sizeof(*frame));
+    if (msg->flags & PCANFD_MSG_EXT)
+        frame->can_id = (msg->id & CAN_EFF_MASK) | CAN_EFF_FLAG;
+    else
+        frame->can_id = msg->id & CAN_SFF_MASK;
+    if (msg->flags & PCANFD_MSG_RTR)
+        frame->can_id |= CAN_RTR_FLAG;
+    frame->can_dlc = msg->dlc;
+    memcpy(frame->data, msg->data, sizeof(frame->data));
+
+    return 0;
+}
+
+static void free_reader(pcan_chardev_reader_t *reader)
+{
+    if (reader)
+    {
+        kfree(reader->out_buf);
+        kvfree(reader);
+    }
+}
 
-    if (open_count > 1)
+static pcan_chardev_reader_t* alloc_reader(usb_forwarder_t *forwarder)
+{
+    pcan_chardev_reader_t *reader = kvzalloc(sizeof(*reader), GFP_KERNEL);
+
+    if (NULL == reader)
+        return NULL;
+
+    reader->forwarder = forwarder;
+    mutex_init(&reader->lock);
+    reader->read_mode = PCANFD_READ_MODE_TEXT;
+    reader->hwts_mode = PCANFD_OPT_HWTIMESTAMP_COOKED; /* Aligned with other adapters, see time_align.h. */
+    reader->text_secs = S64_MIN; /* Date part of text not cached yet. */
+    reader->out_buf = kmalloc(max_t(size_t, PCAN_CHRDEV_MAX_BYTES_PER_READ * PCAN_CHRDEV_MAX_MSGS_PER_READ + 1,
+        sizeof(pcanfd_compact_msg_t) * PCAN_CHRDEV_MAX_MSGS_PER_READ), GFP_KERNEL);
+    if (NULL == reader->out_buf)
     {
-        dev_err_v(forwarder->char_dev.device, "Device has been opened %d times.\n", open_count);
-        atomic_dec(&forwarder->char_dev.open_count);
+        dev_err_v(forwarder->char_dev.device, "Failed to allocate buffers of reader\n");
+        free_reader(reader);
 
-        return -EMFILE;
+        return NULL;
     }
 
-    if (file->f_flags & O_NONBLOCK)
-        dev_notice_v(forwarder->char_dev.device, "Non-blocking mode enabled!\n");
+    return reader;
+}
+
+/* Called by the first opener with open_lock held. */
+static int start_chardev(usb_forwarder_t *forwarder)
+{
+    u16 dev_revision = le16_to_cpu(forwarder->usb_dev->descriptor.bcdDevice) >> 8;
+    int err;
+    int i;
+
+    if ((err = pcan_chardev_resize_rx_buf(&forwarder->char_dev, rx_buf_count)) < 0)
+        return err;
 
-    atomic_set(&forwarder->char_dev.rx_write_idx, 0);
-    atomic_set(&forwarder->char_dev.rx_unread_cnt, 0);
     forwarder->char_dev.rx_packets = 0;
-    atomic_set(&forwarder->char_dev.active_tx_urbs, 0);
+    forwarder->char_dev.tx_packets = 0;
+    WRITE_ONCE(forwarder->char_dev.dev_overrun, false);
+    /* NOTE: Do not reset active_tx_urbs here, since URBs of the last session might be still in flight. */
 
     for (i = PCAN_USB_MAX_TX_URBS; i < PCAN_USB_MAX_TX_URBS * 2; ++i)
     {
         forwarder->tx_contexts[i].urb->complete = usb_write_bulk_callback;
     }
 
-    file->private_data = forwarder;
-
-    if ((stage = atomic_inc_return(&forwarder->stage)) > PCAN_USB_STAGE_ONE_STARTED)
+    if (atomic_inc_return(&forwarder->stage) > PCAN_USB_STAGE_ONE_STARTED)
         return 0;
 
-    memset(&forwarder->time_ref, 0, sizeof(forwarder->time_ref));
+    pcan_time_ref_reset(&forwarder->time_ref);
     ktime_get_real_ts64(&forwarder->bus_up_time);
 
     err = (dev_revision > 3) ? pcan_cmd_set_silent(forwarder, forwarder->can.ctrlmode & CAN_CTRLMODE_LISTENONLY) : 0;
@@ -145,41 +1153,126 @@ static int pcan_chardev_open(struct inode *inode, struct file *file)
         || (err = usbdrv_reset_bus(forwarder, /* is_on = */1)))
     {
         atomic_dec(&forwarder->stage);
-        atomic_dec(&forwarder->char_dev.open_count);
+        free_rx_buf(&forwarder->char_dev);
+    }
+
+    return err;
+}
+
+static int pcan_chardev_open(struct inode *inode, struct file *file)
+{
+    usb_forwarder_t *forwarder = (usb_forwarder_t *)CHRDEV_GRP_FIND_ITEM_PRIVDATA_BY_INODE(inode);
+    pcan_chardev_t *dev = forwarder ? &forwarder->char_dev : NULL;
+    pcan_chardev_reader_t *reader = NULL;
+    int open_count;
+    int err = forwarder ? 0 : -ENODEV;
+
+    if (err)
+        return err;
+
+    if (NULL == (reader = alloc_reader(forwarder)))
+        return -ENOMEM;
+
+    mutex_lock(&dev->open_lock);
+
+    if ((open_count = atomic_read(&dev->open_count)) >= PCAN_CHRDEV_MAX_READERS)
+    {
+        dev_err_v(dev->device, "Device has been opened %d times.\n", open_count);
+        err = -EMFILE;
+    }
+    else
+    {
+        /* Increase it in advance so that decoder starts pushing messages as soon as the bus is on. */
+        atomic_inc(&dev->open_count);
+        if (0 == open_count && (err = start_chardev(forwarder)) < 0)
+            atomic_dec(&dev->open_count);
     }
 
+    if (!err)
+    {
+        pcan_chardev_rx_ring_t *ring = pcan_chardev_lock_rx_ring(dev);
+
+        reader->slot = find_first_zero_bit(&dev->reader_slots, PCAN_CHRDEV_MAX_READERS);
+        reader->cursor = ring ? pcan_chardev_rx_ring_head(ring) : 0; /* Only messages from now on. */
+        WRITE_ONCE(dev->last_accepted[reader->slot], reader->cursor - 1);
+        WRITE_ONCE(dev->allowed_msgs[reader->slot], PCANFD_ALLOWED_MSG_ALL);
+        pcan_chardev_set_rx_wake(dev, reader->slot, 1, 0);
+        reader->status_cursor = smp_load_acquire(&dev->status_queue.head);
+        WRITE_ONCE(dev->status_queue.last_accepted[reader->slot], reader->status_cursor - 1);
+        smp_mb__before_atomic();
+        set_bit(reader->slot, &dev->reader_slots); /* Producer starts filtering for it from now on. */
+        file->private_data = reader;
+#ifdef FMODE_NOWAIT
+        file->f_mode |= FMODE_NOWAIT; /* So that io_uring tries IOCB_NOWAIT first instead of a blocking worker. */
+#endif
+
+        if (file->f_flags & O_NONBLOCK)
+            dev_notice_v(dev->device, "Non-blocking mode enabled!\n");
+    }
+
+    mutex_unlock(&dev->open_lock);
+
+    if (err)
+        free_reader(reader);
+
     return err;
 }
 
 static int pcan_chardev_release(struct inode *inode, struct file *file)
 {
     usb_forwarder_t *forwarder = (usb_forwarder_t *)CHRDEV_GRP_FIND_ITEM_PRIVDATA_BY_INODE(inode);
+    pcan_chardev_reader_t *reader = (pcan_chardev_reader_t *)file->private_data;
     int err = /* forwarder ? */0/* : -ENODEV*/;
 
     if (NULL == forwarder)
         pr_err_v("Can not find forwarder, minor = %u\n", MINOR(inode->i_rdev));
     else
     {
-        file->private_data = NULL;
-        atomic_dec(&forwarder->char_dev.open_count);
-        unmap_user_readbuf_if_needed(&forwarder->char_dev);
-        if (atomic_dec_return(&forwarder->stage) < PCAN_USB_STAGE_ONE_STARTED)
-            /* err = */usbdrv_reset_bus(forwarder, /* is_on = */0);
+        pcan_chardev_t *dev = &forwarder->char_dev;
+
+        if (reader && reader->lost)
+        {
+            dev_notice_v(dev->device, "Reader lost %llu messages in %u overruns, max lag: %u\n",
+                reader->lost, reader->overruns, reader->max_lag);
+        }
+
+        mutex_lock(&dev->open_lock);
+        if (reader)
+        {
+            /* No one else can access filters of this slot now. */
+            pcan_msg_filter_set_t *filters = rcu_dereference_protected(dev->rx_filters[reader->slot], 1);
+
+            clear_bit(reader->slot, &dev->reader_slots);
+            pcan_chardev_set_rx_wake(dev, reader->slot, 1, 0); /* Stops its timer. */
+            RCU_INIT_POINTER(dev->rx_filters[reader->slot], NULL);
+            if (filters)
+                kfree_rcu(filters, rcu);
+        }
+        if (0 == atomic_dec_return(&dev->open_count)) /* The last one. */
+        {
+            free_rx_buf(dev);
+            if (atomic_dec_return(&forwarder->stage) < PCAN_USB_STAGE_ONE_STARTED)
+                /* err = */usbdrv_reset_bus(forwarder, /* is_on = */0);
+        }
+        mutex_unlock(&dev->open_lock);
     }
 
+    file->private_data = NULL;
+    free_reader(reader);
+
     return err;
 }
 
 static inline usb_forwarder_t* get_usb_forwarder_from_file(struct file *file)
 {
-    void *priv_data = file->private_data;
+    pcan_chardev_reader_t *reader = (pcan_chardev_reader_t *)file->private_data;
 
-    return (usb_forwarder_t *)(likely(priv_data) ? priv_data : CHRDEV_GRP_FIND_ITEM_PRIVDATA_BY_INODE(file->f_inode));
+    return likely(reader) ? reader->forwarder : NULL;
 }
 
 #define CHRDEV_OP_PRECHECK(fwd, filp, err)              do { \
     if (unlikely(atomic_read(&(fwd)->stage) < PCAN_USB_STAGE_ONE_STARTED)) { \
-        (filp)->private_data = NULL; \
+        ((pcan_chardev_reader_t *)(filp)->private_data)->forwarder = NULL; \
         return err; \
     } \
 } while (0)
@@ -199,9 +1292,12 @@ static unsigned int pcan_chardev_poll(struct file *file, poll_table *wait)
 
     poll_wait(file, &dev->wait_queue_rd, wait);
 
-    if (atomic_read(&dev->rx_unread_cnt) > 0)
+    if (pcan_chardev_rx_ready(dev, (pcan_chardev_reader_t *)file->private_data))
         mask |= (POLLIN | POLLRDNORM);
 
+    if (pcan_chardev_status_pending(dev, (pcan_chardev_reader_t *)file->private_data) > 0)
+        mask |= POLLPRI;
+
     poll_wait(file, &dev->wait_queue_wr, wait);
 
     if (atomic_read(&dev->active_tx_urbs) < PCAN_USB_MAX_TX_URBS)
@@ -212,13 +1308,107 @@ static unsigned int pcan_chardev_poll(struct file *file, poll_table *wait)
     return mask;
 }
 
+#define HEX_ROW(h)          h "0" h "1" h "2" h "3" h "4" h "5" h "6" h "7" h "8" h "9" h "A" h "B" h "C" h "D" h "E" h "F"
+
+static const char S_HEX_PAIRS[] = HEX_ROW("0") HEX_ROW("1") HEX_ROW("2") HEX_ROW("3")
+    HEX_ROW("4") HEX_ROW("5") HEX_ROW("6") HEX_ROW("7")
+    HEX_ROW("8") HEX_ROW("9") HEX_ROW("A") HEX_ROW("B")
+    HEX_ROW("C") HEX_ROW("D") HEX_ROW("E") HEX_ROW("F");
+
+static inline char* put_hex_byte(char *ptr, u8 val)
+{
+    memcpy(ptr, &S_HEX_PAIRS[val * 2], 2);
+
+    return ptr + 2;
+}
+
+/*
+ * Produces exactly the same line as:
+ *  sprintf(ptr, "(%04ld-%02d-%02d %02d:%02d:%02d.%06ld)  %s  %08X  [%d] " + " %02X" * dlc + "\n", ...)
+ * but the date part is only re-calculated once the second changes,
+ * and the rest is built without parsing any format string.
+ */
+static char* format_text_msg(pcan_chardev_t *dev, pcan_chardev_reader_t *reader, const pcan_rx_record_t *rec,
+    const char *name, size_t name_len, s64 tz_offset, char *ptr)
+{
+    struct timespec64 tspec = ns_to_timespec64(pcan_chardev_record_ts_ns(dev, reader, rec, /* realtime = */true,
+        /* from_device = */NULL));
+    time64_t local_secs = tspec.tv_sec + tz_offset;
+    u32 usecs = tspec.tv_nsec / 1000;
+    u32 can_id = rec->can_id & CAN_EFF_MASK;
+    u8 dlc = min_t(u8, rec->can_dlc, CAN_MAX_DLC);
+    int i;
+
+    if (unlikely(local_secs != reader->text_secs))
+    {
+        struct tm when;
+
+        evol_time_to_tm(tspec.tv_sec, tz_offset, &when);
+        reader->text_date_len = snprintf(reader->text_date, sizeof(reader->text_date), "(%04ld-%02d-%02d %02d:%02d:%02d.",
+            when.tm_year + 1900, when.tm_mon + 1, when.tm_mday, when.tm_hour, when.tm_min, when.tm_sec);
+        reader->text_secs = local_secs;
+    }
+
+    memcpy(ptr, reader->text_date, reader->text_date_len);
+    ptr += reader->text_date_len;
+
+    for (i = 5; i >= 0; --i, usecs /= 10)
+    {
+        ptr[i] = '0' + usecs % 10;
+    }
+    ptr += 6;
+
+    memcpy(ptr, ")  ", 3);
+    ptr += 3;
+    memcpy(ptr, name, name_len);
+    ptr += name_len;
+    *ptr++ = ' ';
+    *ptr++ = ' ';
+
+    ptr = put_hex_byte(ptr, can_id >> 24);
+    ptr = put_hex_byte(ptr, can_id >> 16);
+    ptr = put_hex_byte(ptr, can_id >> 8);
+    ptr = put_hex_byte(ptr, can_id);
+
+    memcpy(ptr, "  [", 3);
+    ptr += 3;
+    *ptr++ = '0' + dlc;
+    *ptr++ = ']';
+    *ptr++ = ' ';
+
+    for (i = 0; i < dlc; ++i)
+    {
+        *ptr++ = ' ';
+        ptr = put_hex_byte(ptr, rec->data[i]);
+    }
+    *ptr++ = '\n';
+
+    return ptr;
+}
+
+/* Non-blocking if the file is opened with O_NONBLOCK, or the request is submitted with IOCB_NOWAIT (e.g.: by io_uring). */
+static inline bool is_nonblocking_iocb(const struct kiocb *iocb)
+{
+#ifdef IOCB_NOWAIT
+    if (iocb->ki_flags & IOCB_NOWAIT)
+        return true;
+#endif
+
+    return iocb->ki_filp->f_flags & O_NONBLOCK;
+}
+
 /* FIXME: Might be buggy ... Test it carefully with pcanusb_test.elf and cat! */
-static ssize_t pcan_chardev_read(struct file *file, char __user *buf, size_t count, loff_t *off)
+static ssize_t pcan_chardev_read_iter(struct kiocb *iocb, struct iov_iter *to)
 {
+    struct file *file = iocb->ki_filp;
+    size_t count = iov_iter_count(to);
+    bool nonblock = is_nonblocking_iocb(iocb);
     usb_forwarder_t *forwarder = get_usb_forwarder_from_file(file);
     pcan_chardev_t *dev = likely(forwarder) ? &forwarder->char_dev : NULL;
-    unsigned long lock_flags;
-    int err = likely(dev) ? ((count > PCAN_CHRDEV_MAX_BYTES_PER_READ) ? 0 : -EINVAL) : -ENODEV;
+    pcan_chardev_reader_t *reader = (pcan_chardev_reader_t *)file->private_data;
+    bool is_compact = (PCANFD_READ_MODE_COMPACT == READ_ONCE(reader->read_mode));
+    size_t min_count = is_compact ? sizeof(pcanfd_compact_msg_t) : (PCAN_CHRDEV_MAX_BYTES_PER_READ + 1);
+    int err = likely(dev) ? ((count >= min_count) ? 0 : -EINVAL) : -ENODEV;
 
     if (err)
         return err;
@@ -227,9 +1417,9 @@ static ssize_t pcan_chardev_read(struct file *file, char __user *buf, size_t cou
 
     atomic_inc(&forwarder->pending_ops);
 
-    if (file->f_flags & O_NONBLOCK)
+    if (nonblock)
     {
-        if (atomic_read(&dev->rx_unread_cnt) <= 0)
+        if (pcan_chardev_rx_pending(dev, reader) <= 0)
         {
             err = -EAGAIN;
             goto lbl_read_end;
@@ -238,7 +1428,7 @@ static ssize_t pcan_chardev_read(struct file *file, char __user *buf, size_t cou
     else
     {
         err = wait_event_interruptible(dev->wait_queue_rd,
-            atomic_read(&dev->rx_unread_cnt) > 0 || atomic_read(&forwarder->stage) < PCAN_USB_STAGE_ONE_STARTED);
+            pcan_chardev_rx_ready(dev, reader) || atomic_read(&forwarder->stage) < PCAN_USB_STAGE_ONE_STARTED);
         if (err)
             goto lbl_read_end;
 
@@ -248,82 +1438,64 @@ static ssize_t pcan_chardev_read(struct file *file, char __user *buf, size_t cou
             goto lbl_read_end;
         }
 
-        if (unlikely(atomic_read(&dev->rx_unread_cnt) <= 0))
+        if (unlikely(pcan_chardev_rx_pending(dev, reader) <= 0))
         {
             err = signal_pending(current) ? -ERESTARTSYS/*-EINTR*/ : -EAGAIN;
             goto lbl_read_end;
         }
     }
 
-    if (map_umem && buf != dev->rd_user_buf)
+    if ((err = pcan_chardev_lock_reader(reader, nonblock)))
+        goto lbl_read_end;
+
+    if (is_compact) /* No formatting, and only 24 bytes per message against 80 bytes of text. */
     {
-        struct page *user_page = NULL;
+        u32 fetched = pcan_chardev_fetch_rx_records(dev, reader, count / sizeof(pcanfd_compact_msg_t));
 
-        if (unlikely(!evol_access_ok(buf, count)))
+        if (unlikely(0 == fetched))
+            err = -EAGAIN;
+        else
         {
-            err = -EINVAL;
-            dev_err_ratelimited_v(dev->device, "access_ok() returned false\n");
-            goto lbl_read_end;
-        }
-
-        unmap_user_readbuf_if_needed(dev);
-
-        err = get_user_pages_fast((unsigned long)buf, 1, FOLL_WRITE, &user_page);
-        if (err < 0)
-            goto lbl_read_end;
+            size_t bytes = fetched * sizeof(pcanfd_compact_msg_t);
 
-        dev->rd_mapped_addr = (char *)kmap(user_page);
-        dev->rd_user_buf = buf;
-        dev_notice_ratelimited_v(dev->device, "Mapped read buffer: 0x%p -> 0x%p\n", buf, dev->rd_mapped_addr);
+            pcan_chardev_compact_rx_records(dev, reader, reader->recs, fetched, reader->out_buf);
+            bytes = copy_to_iter(reader->out_buf, bytes, to);
+            /* The cursor has gone past them all, so report whole messages copied, and a partial one makes no sense. */
+            bytes -= bytes % sizeof(pcanfd_compact_msg_t);
+            err = bytes ? (int)bytes : -EFAULT;
+        }
     }
-
-    spin_lock_irqsave(&dev->lock, lock_flags);
+    else
     {
-        char *buf_start = map_umem ? dev->rd_mapped_addr : dev->rd_kernel_buf;
+        char *buf_start = reader->out_buf;
         char *ptr = buf_start;
-        int unread_msgs = atomic_read(&dev->rx_unread_cnt);
-        int read_index = pcan_chardev_calc_rx_read_index(atomic_read(&dev->rx_write_idx), unread_msgs);
         int msgs_to_read = count / PCAN_CHRDEV_MAX_BYTES_PER_READ + ((count % PCAN_CHRDEV_MAX_BYTES_PER_READ) ? 0 : -1);
-        int i;
+        u32 fetched = (msgs_to_read > 0) ? pcan_chardev_fetch_rx_records(dev, reader, msgs_to_read) : 0;
+        u32 i;
 
-        if (unlikely(unread_msgs <= 0))
+        if (unlikely(msgs_to_read <= 0))
+            err = -EINVAL;
+        else if (unlikely(0 == fetched))
             err = -EAGAIN;
         else
         {
-            if (msgs_to_read > unread_msgs)
-                msgs_to_read = unread_msgs;
+            const char *name = dev_name(dev->device);
+            size_t name_len = strlen(name);
+            s64 tz_offset = 60 * 60 * READ_ONCE(timezone);
 
-            for (i = 0; i < msgs_to_read; ++i)
+            for (i = 0; i < fetched; ++i)
             {
-                struct timespec64 tspec = forwarder->bus_up_time;
-                struct tm when;
-                pcan_chardev_msg_t *rx_msg = &dev->rx_msgs[read_index];
-                struct can_frame *f = &rx_msg->frame;
-                typeof(f->can_dlc) j;
-
-                timespec64_add_ns(&tspec, ktime_to_ns(ktime_sub(rx_msg->hwtstamp, forwarder->time_ref.tv_host_0)));
-                evol_time_to_tm(tspec.tv_sec, 60 * 60 * timezone, &when);
-                ptr += sprintf(ptr, "(%04ld-%02d-%02d %02d:%02d:%02d.%06ld)  %s  %08X  [%d] ",
-                    when.tm_year + 1900, when.tm_mon + 1, when.tm_mday, when.tm_hour, when.tm_min, when.tm_sec,
-                    tspec.tv_nsec / 1000, dev_name(dev->device), (f->can_id & CAN_EFF_MASK), f->can_dlc);
-                for (j = 0; j < f->can_dlc; ++j)
-                {
-                    ptr += sprintf(ptr, " %02X", f->data[j]);
-                }
-                *ptr++ = '\n';
-
-                read_index = (read_index + 1) % PCAN_CHRDEV_MAX_RX_BUF_COUNT;
+                ptr = format_text_msg(dev, reader, &reader->recs[i], name, name_len, tz_offset, ptr);
             }
 
-            atomic_sub(msgs_to_read, &dev->rx_unread_cnt);
-            err = ptr - buf_start;
-            ptr[err] = '\0';
+            *ptr = '\0';
+            err = copy_to_iter(buf_start, ptr - buf_start, to);
+            if (unlikely(0 == err))
+                err = -EFAULT;
         }
     }
-    spin_unlock_irqrestore(&dev->lock, lock_flags);
 
-    if (!map_umem && err > 0)
-        err -= copy_to_user(buf, dev->rd_kernel_buf, err);
+    mutex_unlock(&reader->lock);
 
 lbl_read_end:
 
@@ -332,9 +1504,134 @@ lbl_read_end:
     return err;
 }
 
-static ssize_t pcan_chardev_write(struct file *file, const char __user *buf, size_t count, loff_t *off)
+static void rx_ring_vma_open(struct vm_area_struct *vma)
 {
-    return -EOPNOTSUPP; /* TODO */
+    pcan_chardev_rx_ring_t *ring = (pcan_chardev_rx_ring_t *)vma->vm_private_data;
+
+    kref_get(&ring->refs);
+}
+
+static void rx_ring_vma_close(struct vm_area_struct *vma)
+{
+    pcan_chardev_rx_ring_t *ring = (pcan_chardev_rx_ring_t *)vma->vm_private_data;
+
+    kref_put(&ring->refs, release_rx_ring);
+}
+
+static const struct vm_operations_struct S_RX_RING_VM_OPS = {
+    .open = rx_ring_vma_open,
+    .close = rx_ring_vma_close,
+};
+
+static int pcan_chardev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    usb_forwarder_t *forwarder = get_usb_forwarder_from_file(file);
+    pcan_chardev_t *dev = likely(forwarder) ? &forwarder->char_dev : NULL;
+    pcan_chardev_rx_ring_t *ring;
+    int err = likely(dev) ? 0 : -ENODEV;
+
+    if (err)
+        return err;
+
+    CHRDEV_OP_PRECHECK(forwarder, file, -ENODEV);
+
+    if (vma->vm_pgoff) /* Partial mapping makes no sense to a ring. */
+        return -EINVAL;
+
+    if (vma->vm_flags & VM_WRITE) /* The ring is shared by all openers. */
+        return -EPERM;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_clear(vma, VM_MAYWRITE);
+#else
+    vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+    mutex_lock(&dev->open_lock);
+
+    ring = pcan_chardev_lock_rx_ring(dev);
+    if (unlikely(NULL == ring))
+        err = -ENODEV;
+    else if (vma->vm_end - vma->vm_start > ring->mem_size)
+        err = -EINVAL;
+    else if (0 == (err = remap_vmalloc_range(vma, ring->ctrl, 0)))
+    {
+        vma->vm_ops = &S_RX_RING_VM_OPS;
+        vma->vm_private_data = ring;
+        rx_ring_vma_open(vma);
+        dev_notice_v(dev->device, "Rx ring mapped: %lu bytes of %zu\n", vma->vm_end - vma->vm_start, ring->mem_size);
+    }
+
+    mutex_unlock(&dev->open_lock);
+
+    return err;
+}
+
+/* Messages converted on stack at a time by write(), enough to fill two Tx URBs. */
+#define TX_CHUNK_MSGS                           (PCAN_USB_MAX_FRAMES_PER_URB * 2)
+
+/*
+ * Takes an array of struct pcanfd_compact_msg (timestamps ignored) regardless of read mode,
+ * which may be scattered over several buffers as long as the total size is a multiple of a message.
+ */
+static ssize_t pcan_chardev_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+    struct file *file = iocb->ki_filp;
+    size_t count = iov_iter_count(from);
+    bool nonblock = is_nonblocking_iocb(iocb);
+    usb_forwarder_t *forwarder = get_usb_forwarder_from_file(file);
+    pcan_chardev_t *dev = likely(forwarder) ? &forwarder->char_dev : NULL;
+    size_t total = count / sizeof(pcanfd_compact_msg_t);
+    size_t done = 0;
+    int err = likely(dev) ? (total ? 0 : -EINVAL) : -ENODEV;
+
+    if (err)
+        return err;
+
+    CHRDEV_OP_PRECHECK(forwarder, file, -ENODEV);
+
+    atomic_inc(&forwarder->pending_ops);
+
+    while (done < total)
+    {
+        pcanfd_compact_msg_t msgs[TX_CHUNK_MSGS];
+        struct can_frame frames[TX_CHUNK_MSGS];
+        u32 n = min_t(size_t, total - done, TX_CHUNK_MSGS);
+        u32 valid;
+        int ret;
+
+        if (unlikely(!copy_from_iter_full(msgs, n * sizeof(msgs[0]), from)))
+        {
+            err = -EFAULT;
+            break;
+        }
+
+        for (valid = 0; valid < n; ++valid)
+        {
+            if ((err = compact_msg_to_frame(&msgs[valid], &frames[valid])))
+                break;
+        }
+
+        if (valid > 0) /* Send the valid ones ahead of an invalid one anyway. */
+        {
+            if ((ret = pcan_chardev_send_frames(forwarder, frames, valid, nonblock)) < 0)
+            {
+                err = ret;
+                break;
+            }
+
+            done += ret;
+            if ((u32)ret < valid)
+                break;
+        }
+
+        if (err)
+            break;
+    }
+
+    atomic_dec(&forwarder->pending_ops);
+
+    return done ? (ssize_t)(done * sizeof(pcanfd_compact_msg_t)) : err;
 }
 
 static long pcan_chardev_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
@@ -377,6 +1674,8 @@ static long pcan_chardev_ioctl(struct file *file, unsigned int cmd, unsigned lon
     case PCANFD_IOCTL_SET_INIT:
     case PCANFD_IOCTL_GET_INIT:
     case PCANFD_IOCTL_GET_STATE:
+    case PCANFD_IOCTL_ADD_FILTERS:
+    case PCANFD_IOCTL_GET_FILTERS:
     case PCANFD_IOCTL_SEND_MSG:
     case PCANFD_IOCTL_RECV_MSG:
     case PCANFD_IOCTL_SEND_MSGS:
@@ -384,9 +1683,10 @@ static long pcan_chardev_ioctl(struct file *file, unsigned int cmd, unsigned lon
     case PCANFD_IOCTL_GET_OPTION:
     case PCANFD_IOCTL_SET_OPTION:
     case PCANFD_IOCTL_RESET:
+    case PCANFD_IOCTL_RECV_COMPACT_MSGS:
         handler = &G_FD_IOCTL_HANDLERS[_IOC_NR(cmd) - PCANFD_IOCTL_SEQ_START];
         if (PCANFD_IOCTL_SEND_MSG != cmd && PCANFD_IOCTL_RECV_MSG != cmd &&
-            PCANFD_IOCTL_SEND_MSGS != cmd && PCANFD_IOCTL_RECV_MSGS != cmd)
+            PCANFD_IOCTL_SEND_MSGS != cmd && PCANFD_IOCTL_RECV_MSGS != cmd && PCANFD_IOCTL_RECV_COMPACT_MSGS != cmd)
         {
             dev_notice_ratelimited_v(dev->device, "cmd[%s|0x%08x]: direction = %u, type = %u, number = %u, size = %u\n",
                 handler->name, cmd, _IOC_DIR(cmd), _IOC_TYPE(cmd), _IOC_NR(cmd), _IOC_SIZE(cmd)); \
@@ -411,8 +1711,14 @@ static const struct file_operations S_FILE_OPS = {
     .open = pcan_chardev_open,
     .release = pcan_chardev_release,
     .poll = pcan_chardev_poll,
-    .read = pcan_chardev_read,
-    .write = pcan_chardev_write,
+    .read_iter = pcan_chardev_read_iter,
+    .write_iter = pcan_chardev_write_iter,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 5, 0)
+    .splice_read = copy_splice_read, /* Into pipe buffers through read_iter(), with no user copy. */
+#else
+    .splice_read = generic_file_splice_read,
+#endif
+    .mmap = pcan_chardev_mmap,
     .unlocked_ioctl = pcan_chardev_ioctl,
 };
 
@@ -448,5 +1754,54 @@ const struct file_operations* get_file_operations(void)
  *
  * >>> 2023-12-28, Man Hung-Coeng <udc577@126.com>:
  *  01. Re-implement the read function with character stream format.
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Allocate the Rx ring buffer on open with a capacity specified by
+ *      the new module parameter rx_buf_count or PCANFD_OPT_RX_BUF_COUNT option,
+ *      and replace modulo operations on ring indexes with masks.
+ *  02. Never let the read function write beyond the single mapped page
+ *      or the terminating null character beyond the kernel buffer.
+ *  03. Make the Rx ring lock-free between decoder and readers,
+ *      so that readers never disable interrupts and decoder never spins on them.
+ *  04. Add a concurrent producer/consumer stress test for the Rx ring (INNER_TEST only).
+ *  05. Implement mmap() to expose the Rx ring to user space without copying,
+ *      and remove module parameter map_umem together with its one-page trick.
+ *  06. Allow up to PCAN_CHRDEV_MAX_READERS concurrent opens, each of which
+ *      reads the broadcast Rx ring with its own cursor, lag and overrun counters.
+ *  07. Make read() return compact binary messages if the opener has switched
+ *      to PCANFD_READ_MODE_COMPACT, and accept PCANFD_IOCTL_RECV_COMPACT_MSGS.
+ *  08. Format text lines of read() without sprintf() on each message:
+ *      cache the date part per second, and convert bytes to hex by a lookup table.
+ *  09. Remove the ioctl staging buffer of reader.
+ *  10. Implement the Tx path on the second half of Tx URBs: write() taking compact messages,
+ *      pcan_chardev_send_frames() shared with ioctl(), and a real Tx completion callback.
+ *  11. Pack as many frames of a batch as possible into a Tx URB.
+ *  12. Account records overwritten before being read in device-wide drop counters too,
+ *      and remember how many are lost right before the first record of each fetch.
+ *  13. Assign each opener a slot, evaluate message filters of all slots before writing
+ *      a record into the Rx ring, and skip records not accepted by the reader when fetching.
+ *  14. Reject messages of types not allowed by an opener before writing them into the Rx ring.
+ *  15. Queue bus status and error events apart from data messages, deliver them ahead of the latter,
+ *      signal them with POLLPRI, and convert them into PCANFD_TYPE_STATUS messages.
+ *  16. Moderate reader wakeups per open by count of messages and an hrtimer,
+ *      and make poll() and blocking read() wait for the same thresholds.
+ *  17. Replace read() and write() with read_iter() and write_iter(), which support vectored I/O,
+ *      and treat IOCB_NOWAIT as O_NONBLOCK.
+ *  18. Support splice() from the chardev into a pipe.
+ *  19. Publish messages pushed into the Rx ring once per URB with a single head update,
+ *      and at most one wakeup, and print cycles per message of producer in the self-test.
+ *  20. Stamp messages of read() and compact ones in the PCANFD_OPT_HWTIMESTAMP_* mode of each opener.
+ *  21. Reset the clock model through pcan_time_ref_reset() on first open.
+ *  22. Store raw ticks and an epoch into records, publish conversion parameters of each epoch
+ *      before any record refers to it, and convert timestamps only when records are read.
+ *  23. Rewrite the conversion parameters of an epoch in place when the clock model is steered within it,
+ *      and convert a record whose epoch has been reused by the latest epoch instead of by host time.
+ *  24. Never rewrite parameters of an epoch in place, keep the control block in as many pages as it takes,
+ *      and report records of reused epochs by host time with PCANFD_COMPACT_HOST_TS (or without PCANFD_HWTIMESTAMP)
+ *      instead of converting them by another epoch.
+ *  25. Add pcan_chardev_can_status().
+ *  26. Count the record being overwritten at the cursor as lost at once instead of spinning
+ *      till the producer publishes it.
+ *  27. Start readers in PCANFD_OPT_HWTIMESTAMP_COOKED mode, so that adapters are aligned by default.
  */
 
@@ -13,54 +13,387 @@
 /* (2023-12-31 23:59:59.999999)  pcanusb32  10203040  [8]  00 00 00 00 00 00 00 00\n */
 #define PCAN_CHRDEV_MAX_BYTES_PER_READ          80
 
-#define PCAN_CHRDEV_MAX_RX_BUF_COUNT            8
+/* Upper limit of messages handled by a single read(), or fetched at a time by PCANFD_IOCTL_RECV_*MSGS requests. */
+#define PCAN_CHRDEV_MAX_MSGS_PER_READ           64
+
+/* Capacity of Rx ring buffer, which is always rounded up to a power of 2. */
+#define PCAN_CHRDEV_MIN_RX_BUF_COUNT            8
+#define PCAN_CHRDEV_DEFAULT_RX_BUF_COUNT        4096
+#define PCAN_CHRDEV_MAX_RX_BUF_COUNT            (1 << 19)
+
+/* Upper limit of concurrent opens of a chardev, each of which reads the Rx ring independently. */
+#define PCAN_CHRDEV_MAX_READERS                 8 /* no more than bits of readers of struct pcan_rx_record */
+
+/* Capacity of the status queue, which must be a power of 2. */
+#define PCAN_CHRDEV_STATUS_QUEUE_LEN            16
+
+/*
+ * Count of the latest epochs of timestamp conversion kept, which must be a power of 2.
+ * An epoch begins on every change of the clock model, i.e., about every 1.4 s, and on changes of settings,
+ * so 512 of them cover about 12 minutes, much longer than the deepest ring takes to fill up at full bus load.
+ */
+#define PCAN_RX_TS_EPOCHS                       512
+
+#include <linux/types.h> /* For __u32, etc. */
+
+/*
+ * Layout of the Rx ring shared with user space through mmap() at offset 0:
+ *  - offset 0 till records_offset (page-aligned): control block, i.e., struct pcan_rx_ring_ctrl,
+ *  - records_offset and after: an array of struct pcan_rx_record with capacity items.
+ *
+ * The ring is written once by the driver and read by any number of consumers,
+ * each of which keeps its own cursor and never holds the producer back:
+ * the oldest record is overwritten when the ring is full.
+ *
+ * A consumer in user space loads head with acquire semantics, and for each
+ * index i in [cursor, head) (record = records[i & (capacity - 1)]):
+ *  1. loads seq of record with acquire semantics, and stops if it isn't i;
+ *  2. copies the record;
+ *  3. issues a read barrier and loads seq again, and stops if it isn't i.
+ * A mismatched seq means the consumer has been overrun, and should restart
+ * from (head - capacity). It only needs to poll() when cursor == head.
+ *
+ * A record is written only if message filters of at least one opener accept it,
+ * and its readers field tells which ones, which a consumer in user space may just ignore.
+ *
+ * Timestamps are stored in raw form, i.e., device ticks plus an epoch, whose conversion parameters
+ * are in ts_epochs[epoch & (PCAN_RX_TS_EPOCHS - 1)] of the control block, written before any record
+ * referring to them, and never changed till reused by a newer epoch, so every record is converted
+ * by the parameters in effect when it was received. A consumer copies an entry as a sequence lock:
+ * it retries while seq is odd or has changed during the copy. An entry of another epoch means that
+ * the one of the record has been reused, i.e., the record is too old to be converted at all,
+ * so ts_host_ns is reported instead, and marked so (see PCANFD_HWTIMESTAMP and PCANFD_COMPACT_HOST_TS).
+ * Realtime timestamps are those of CLOCK_MONOTONIC plus the offset of CLOCK_REALTIME when read.
+ */
+#define PCAN_RX_RING_VERSION                    7
+
+typedef struct pcan_rx_record
+{
+    __u32 seq; /* free-running index at which this record was written */
+    __u32 can_id; /* the same as can_id of struct can_frame */
+    __u8 can_dlc;
+    __u8 readers; /* bit i is set if accepted by the opener in slot i */
+    __u8 reserved[2];
+    __u32 ts_raw; /* raw timestamp from device, in ticks of 42.666 us */
+    __u8 data[8];
+    __u64 ts_ticks; /* device time in ticks since bus on, i.e., ts_raw extended to 64 bits */
+    __u64 ts_host_ns; /* CLOCK_MONOTONIC when the message was received by host */
+    __u32 ts_epoch; /* of the conversion of ts_ticks into host time, 0 if there is no device timestamp */
+    __u8 reserved2[20]; /* keeps records in their own cache lines */
+} pcan_rx_record_t;
+
+/*
+ * Conversion of device ticks into CLOCK_MONOTONIC nanoseconds in an epoch:
+ *  - PCANFD_OPT_HWTIMESTAMP_ON: hw_host_ns + (ticks - hw_ticks) * hw_ns_per_tick_q32 / 2^32,
+ *  - PCANFD_OPT_HWTIMESTAMP_COOKED: the same with cooked_* fields, which compensate clock drift of device,
+ * where (ticks - *_ticks) is a signed value.
+ */
+typedef struct pcan_rx_ts_epoch
+{
+    __u32 seq; /* odd while being written */
+    __u32 epoch; /* 0 if never written */
+    __u64 hw_ticks;
+    __u64 hw_host_ns;
+    __u64 hw_ns_per_tick_q32; /* nominal tick length in 32.32 fixed point */
+    __u64 cooked_ticks;
+    __u64 cooked_host_ns;
+    __u64 cooked_ns_per_tick_q32;
+    __u64 reserved2;
+} pcan_rx_ts_epoch_t;
+
+typedef struct pcan_rx_ring_ctrl
+{
+    __u32 version; /* PCAN_RX_RING_VERSION */
+    __u32 record_size; /* sizeof(struct pcan_rx_record) */
+    __u32 capacity; /* count of records, always a power of 2 */
+    __u32 records_offset; /* in bytes, from the beginning of mapping */
+    __u32 head __attribute__((aligned(64))); /* written by driver only */
+    pcan_rx_ts_epoch_t ts_epochs[PCAN_RX_TS_EPOCHS] __attribute__((aligned(64))); /* written by driver only */
+} pcan_rx_ring_ctrl_t;
 
 #ifdef __KERNEL__
 
 #include <linux/can.h>
 #include <linux/cdev.h>
+#include <linux/hrtimer.h>
+#include <linux/kref.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+
+struct pcanfd_compact_msg;
+struct pcan_msg_filter_set;
+struct pcan_timestamps;
+struct usb_forwarder;
+
+/*
+ * Single-producer multiple-consumer broadcast ring buffer:
+ *  - head is only written by the decoder (i.e., the Rx URB completion handler,
+ *    which is never re-entered for a device since completions are given back serially),
+ *    and published with release semantics once for all records decoded from a URB,
+ *    which are written at next and after privately till then,
+ *  - seq of each record works like a sequence lock, so that a reader can tell
+ *    whether the record it has just copied was overwritten in the meantime,
+ *  - every reader (see struct pcan_chardev_reader below) has its own cursor.
+ */
+typedef struct pcan_chardev_rx_ring
+{
+    struct kref refs; /* one for chardev, and one for each VMA mapping it */
+    u32 mask; /* capacity - 1 */
+    u32 head; /* master copy of ctrl->head, which might be messed up through mmap() */
+    u32 next; /* index of the next record to write, ahead of head by the batch pushed but not published yet */
+    u32 ts_epoch; /* the latest epoch copied into ctrl->ts_epochs */
+    u8 batch_readers; /* slots accepting any record of the batch */
+    u32 batch_last[PCAN_CHRDEV_MAX_READERS]; /* index of the last record of the batch accepted by each slot */
+    u32 batch_count[PCAN_CHRDEV_MAX_READERS]; /* count of records of the batch accepted by each slot */
+    size_t mem_size; /* size of memory allocated by vmalloc_user(), page-aligned */
+    pcan_rx_ring_ctrl_t *ctrl; /* beginning of memory above */
+    pcan_rx_record_t *records;
+} pcan_chardev_rx_ring_t;
 
-struct pcanfd_ioctl_msgs;
+/*
+ * Bus status and error events, kept apart from the Rx ring so that floods of data messages never push them out.
+ * It works the same way as the Rx ring, except that it's much smaller, never resized nor mapped,
+ * and always read before the Rx ring.
+ */
+typedef struct pcan_chardev_status_queue
+{
+    u32 head; /* written by decoder only */
+    u32 last_accepted[PCAN_CHRDEV_MAX_READERS]; /* index of the last record accepted by each slot */
+    pcan_rx_record_t records[PCAN_CHRDEV_STATUS_QUEUE_LEN];
+} pcan_chardev_status_queue_t;
+
+/* Wakeup moderation of an opener slot, see PCANFD_OPT_RX_WAKEUP in chardev_ioctl.h. */
+typedef struct pcan_chardev_rx_wake
+{
+    u32 frames; /* wakes the reader up once so many messages accepted, 1 by default */
+    u32 usecs; /* or so long after the first of them, 0 (by default) to disable */
+    atomic_t unwoken; /* messages accepted since the last wakeup */
+    bool expired; /* set by timer, and cleared when the next batch begins */
+    struct hrtimer timer; /* flushes a batch smaller than frames */
+    struct pcan_chardev *dev;
+} pcan_chardev_rx_wake_t;
 
-typedef struct pcan_chardev_msg
+/* Rx frames dropped by driver, by reason, see struct pcan_rx_drops in chardev_ioctl.h. */
+typedef struct pcan_chardev_rx_drops
 {
-    ktime_t hwtstamp; /* hardware timestamp */
-    struct can_frame frame;
-} pcan_chardev_msg_t;
+    atomic64_t overwritten; /* added by readers on overruns */
+    atomic64_t no_skb; /* the rest are updated by decoder only */
+    atomic64_t dev_overruns;
+    atomic64_t decode_errors;
+} pcan_chardev_rx_drops_t;
 
 typedef struct pcan_chardev
 {
-    struct pcanfd_ioctl_msgs *ioctl_rxmsgs;
-    pcan_chardev_msg_t rx_msgs[PCAN_CHRDEV_MAX_RX_BUF_COUNT];
-    atomic_t rx_write_idx; /* index of message item to write */
-    atomic_t rx_unread_cnt; /* count of unread items */
+    pcan_chardev_rx_ring_t __rcu *rx_ring; /* allocated on first open, replaced or freed with open_lock held */
+    u32 rx_buf_count; /* capacity of rx_ring, always a power of 2 */
     u64 rx_packets; /* or atomic64_t*/
+    u64 tx_packets; /* updated by Tx URB completions only */
+    pcan_chardev_rx_drops_t rx_drops; /* never reset after initialization */
+    bool dev_overrun; /* whether the latest error message of device tells an Rx overrun, written by decoder only */
+    unsigned long reader_slots; /* bit i is set if slot i is taken by an opener, changed with open_lock held */
+    u32 last_accepted[PCAN_CHRDEV_MAX_READERS]; /* index of the last record accepted by each slot */
+    struct pcan_msg_filter_set __rcu *rx_filters[PCAN_CHRDEV_MAX_READERS]; /* of each slot, NULL to accept all */
+    u32 allowed_msgs[PCAN_CHRDEV_MAX_READERS]; /* PCANFD_ALLOWED_MSG_* of each slot */
+    pcan_chardev_status_queue_t status_queue;
+    u32 ts_epoch; /* the latest epoch written into ts_epochs, by decoder only */
+    pcan_rx_ts_epoch_t ts_epochs[PCAN_RX_TS_EPOCHS]; /* for readers in kernel, and kept across ring resizing */
+    pcan_chardev_rx_wake_t rx_wake[PCAN_CHRDEV_MAX_READERS]; /* of each slot */
     struct device *device;
     atomic_t open_count;
     atomic_t active_tx_urbs;
-    spinlock_t lock;
+    struct mutex open_lock; /* serializes open(), release() and replacement of rx_ring */
     wait_queue_head_t wait_queue_rd; /* wait queue for reading */
     wait_queue_head_t wait_queue_wr; /* wait queue for writing */
-    char *rd_user_buf;
-    union
-    {
-        char *rd_mapped_addr; /* mapping of rd_user_buf above */
-        char *rd_kernel_buf;
-    };
     u32 serial_number;
     u32 device_id;
     u32 ioctl_init_flags;
 } pcan_chardev_t;
 
-static inline int pcan_chardev_calc_rx_read_index(int write_index, int unread_msgs)
+/* Per-open state, i.e., private_data of struct file. */
+typedef struct pcan_chardev_reader
+{
+    struct usb_forwarder *forwarder; /* set to NULL once the device is found unplugged */
+    struct mutex lock; /* serializes reading through this file, and changing its filters */
+    u32 slot; /* index of dev->rx_filters, etc. */
+    u32 cursor; /* free-running index of the next record to read */
+    u32 status_cursor; /* free-running index of the next record of status queue to read */
+    u32 max_lag; /* the most records ever left unread */
+    u32 overruns; /* times of being overrun by producer */
+    u64 lost; /* records overwritten before being read */
+    u32 gap; /* records lost right before recs[0] by the last fetch */
+    u32 read_mode; /* PCANFD_READ_MODE_*, for read() */
+    u32 hwts_mode; /* PCANFD_OPT_HWTIMESTAMP_*, for messages read in any way but mmap() */
+    u32 text_date_len;
+    time64_t text_secs; /* local time in seconds which text_date belongs to */
+    char text_date[32]; /* cached date part of text line, e.g.: "(2023-12-31 23:59:59." */
+    void *out_buf; /* text lines or compact messages to copy to user */
+    pcan_rx_record_t recs[PCAN_CHRDEV_MAX_MSGS_PER_READ]; /* snapshot of records being read */
+} pcan_chardev_reader_t;
+
+static inline u32 pcan_chardev_rx_ring_head(const pcan_chardev_rx_ring_t *ring)
+{
+    return smp_load_acquire(&ring->head); /* pairs with smp_store_release() of producer */
+}
+
+static inline pcan_rx_record_t* pcan_chardev_rx_ring_slot(pcan_chardev_rx_ring_t *ring, u32 index)
 {
-    return (write_index + PCAN_CHRDEV_MAX_RX_BUF_COUNT - unread_msgs) % PCAN_CHRDEV_MAX_RX_BUF_COUNT;
+    return &ring->records[index & ring->mask];
+}
+
+/* Count of unread status records of a reader, can be called anywhere, and works like the function below. */
+static inline u32 pcan_chardev_status_pending(pcan_chardev_t *dev, const pcan_chardev_reader_t *reader)
+{
+    u32 cursor = READ_ONCE(reader->status_cursor);
+    u32 lag = smp_load_acquire(&dev->status_queue.head) - cursor;
+
+    if (READ_ONCE(dev->status_queue.last_accepted[reader->slot]) - cursor < lag)
+        return min_t(u32, lag, PCAN_CHRDEV_STATUS_QUEUE_LEN);
+
+    return 0;
+}
+
+/*
+ * Count of unread messages (status records included) of a reader, can be called anywhere.
+ * It's 0 if none of them is accepted by filters of the reader, otherwise an upper bound
+ * including those filtered out, which fetching skips.
+ */
+static inline u32 pcan_chardev_rx_pending(pcan_chardev_t *dev, const pcan_chardev_reader_t *reader)
+{
+    pcan_chardev_rx_ring_t *ring;
+    u32 count = 0;
+
+    rcu_read_lock();
+    ring = rcu_dereference(dev->rx_ring);
+    if (ring)
+    {
+        u32 cursor = READ_ONCE(reader->cursor);
+        u32 lag = pcan_chardev_rx_ring_head(ring) - cursor;
+
+        if (READ_ONCE(dev->last_accepted[reader->slot]) - cursor < lag)
+            count = min_t(u32, lag, ring->mask + 1);
+    }
+    rcu_read_unlock();
+
+    return count + pcan_chardev_status_pending(dev, reader);
+}
+
+/*
+ * Tells whether a blocked reader should be woken up, by thresholds of its wakeup moderation:
+ * status records are always urgent, and messages are when enough of them are pending,
+ * or the oldest of them has waited long enough.
+ */
+static inline bool pcan_chardev_rx_ready(pcan_chardev_t *dev, const pcan_chardev_reader_t *reader)
+{
+    const pcan_chardev_rx_wake_t *wake = &dev->rx_wake[reader->slot];
+    u32 pending;
+
+    if (pcan_chardev_status_pending(dev, reader) > 0)
+        return true;
+
+    pending = pcan_chardev_rx_pending(dev, reader);
+
+    return pending >= READ_ONCE(wake->frames) || (pending > 0 && READ_ONCE(wake->expired));
+}
+
+static inline int pcan_chardev_lock_reader(pcan_chardev_reader_t *reader, bool nonblock)
+{
+    if (nonblock)
+        return mutex_trylock(&reader->lock) ? 0 : -EAGAIN;
+
+    return mutex_lock_interruptible(&reader->lock);
+}
+
+static inline pcan_chardev_rx_ring_t* pcan_chardev_lock_rx_ring(pcan_chardev_t *dev)
+{
+    return rcu_dereference_protected(dev->rx_ring, lockdep_is_held(&dev->open_lock));
 }
 
 int pcan_chardev_initialize(pcan_chardev_t *dev);
 
 void pcan_chardev_finalize(pcan_chardev_t *dev);
 
+/*
+ * Sets wakeup moderation of a slot: wake up its reader once frames messages are accepted,
+ * or usecs microseconds after the first of them (0 to disable, only if frames is 1).
+ * Returns -EINVAL if out of range.
+ */
+int pcan_chardev_set_rx_wake(pcan_chardev_t *dev, u32 slot, u32 frames, u32 usecs);
+
+/*
+ * Re-allocates the Rx ring buffer with (at least) the specified capacity,
+ * unread messages are discarded. Must be called in process context with open_lock held,
+ * and cursors of existing readers must be reset to 0 afterwards.
+ * Returns -EBUSY if the current ring is mapped into user space.
+ */
+int pcan_chardev_resize_rx_buf(pcan_chardev_t *dev, u32 count);
+
+/*
+ * Called by decoder (the only producer) without any lock,
+ * returns -ESHUTDOWN if device not opened. The oldest message is overwritten if Rx buffer is full,
+ * and the message is discarded if allowed message types or filters of all readers reject it.
+ * The message is invisible to readers until pcan_chardev_publish_rx_msgs() is called.
+ */
+int pcan_chardev_push_rx_msg(pcan_chardev_t *dev, const struct can_frame *frame, const struct pcan_timestamps *ts);
+
+/*
+ * Called by decoder after pushing all messages of a URB, to make them visible to readers at a time,
+ * and wake readers up (once at most) according to their wakeup moderation.
+ */
+void pcan_chardev_publish_rx_msgs(pcan_chardev_t *dev);
+
+/*
+ * Called by decoder with bus status and error events, which go to the status queue,
+ * and are discarded if allowed message types or filters of all readers reject them.
+ * Returns -ESHUTDOWN if device not opened.
+ */
+int pcan_chardev_push_status(pcan_chardev_t *dev, const struct can_frame *frame, const struct pcan_timestamps *ts);
+
+/*
+ * Timestamp of a record in nanoseconds, converted according to the PCANFD_OPT_HWTIMESTAMP_* mode of the reader:
+ * of CLOCK_REALTIME if realtime is true and CLOCK_MONOTONIC otherwise, or of device clock in raw mode.
+ * Start-of-frame modes are taken as their end-of-frame counterparts, since the device can't tell SOF.
+ * Host time is returned instead if the mode is PCANFD_OPT_HWTIMESTAMP_OFF, the record has no device time,
+ * or parameters of its epoch have been reused, and *from_device (if not NULL) tells which.
+ */
+u64 pcan_chardev_record_ts_ns(pcan_chardev_t *dev, const pcan_chardev_reader_t *reader, const pcan_rx_record_t *rec,
+    bool realtime, bool *from_device);
+
+/*
+ * Copies at most max_count unread records of the reader into reader->recs, those of the status queue first,
+ * and returns the count copied. Must be called with reader->lock held.
+ * Records overwritten before being copied are accounted in reader->lost, reader->gap
+ * and dev->rx_drops.overwritten, and records not accepted by filters of the reader are skipped.
+ */
+u32 pcan_chardev_fetch_rx_records(pcan_chardev_t *dev, pcan_chardev_reader_t *reader, u32 max_count);
+
+/*
+ * Sends frames through the Tx URBs reserved for chardev, each of which carries as many frames as it can.
+ * If no URB is free, waits for one unless nonblock is true.
+ * Returns the count of frames submitted, or a negative error code if nothing submitted
+ * (-EAGAIN if nonblock is true and no URB is free).
+ */
+int pcan_chardev_send_frames(struct usb_forwarder *forwarder, const struct can_frame *frames, u32 count, bool nonblock);
+
+/*
+ * Returns true if the record is of a bus status event, whose PCANFD_ERROR_{ACTIVE,...,BUSOFF} or PCANFD_RX_OVERFLOW
+ * is stored into *status, and PCANFD_ERROR_{BUS,CTRLR} into *flags.
+ */
+bool pcan_chardev_status_of_record(const pcan_rx_record_t *rec, u32 *status, u32 *flags);
+
+/* Current bus state as PCANFD_ERROR_{ACTIVE,...,BUSOFF}, or PCANFD_UNKNOWN if controller is stopped. */
+u32 pcan_chardev_bus_state(const struct usb_forwarder *forwarder);
+
+/* Current PCANFD_CANSTATUS_* bits, see can_status of struct pcanfd_ioctl_state. */
+u16 pcan_chardev_can_status(const struct usb_forwarder *forwarder);
+
+/* Converts records fetched by function above into compact messages, stamped in the timestamp mode of reader. */
+void pcan_chardev_compact_rx_records(pcan_chardev_t *dev, const pcan_chardev_reader_t *reader,
+    const pcan_rx_record_t *recs, u32 count, struct pcanfd_compact_msg *msgs);
+
+#ifdef INNER_TEST
+int pcan_chardev_rx_ring_selftest(void);
+#endif
+
 const struct file_operations* get_file_operations(void);
 
 #endif /* #ifdef __KERNEL__ */
@@ -89,5 +422,40 @@ const struct file_operations* get_file_operations(void);
  * >>> 2023-12-28, Man Hung-Coeng <udc577@126.com>:
  *  01. Shrink the rx_msgs field of struct pcan_chardev,
  *      and add new fields and macro corresponding to read function.
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Turn rx_msgs into a power-of-2-sized ring buffer allocated on open,
+ *      and add pcan_chardev_resize_rx_buf() and pcan_chardev_push_rx_msg().
+ *  02. Re-implement the Rx buffer as a lock-free single-producer multi-consumer ring,
+ *      with a cursor and a mutex serializing reads per opener instead of the spin lock.
+ *  03. Store binary records in the Rx ring, which can be mapped into user space
+ *      together with a control page, and remove fields for mapping user read buffer.
+ *  04. Turn the Rx ring into a broadcast one read by multiple openers,
+ *      each of which has its own cursor and statistics in struct pcan_chardev_reader.
+ *  05. Add a per-open read mode, and pcan_chardev_compact_rx_records()
+ *      for reading messages in compact binary format.
+ *  06. Add fields for caching the date part of text lines of read().
+ *  07. Remove the ioctl staging buffer of reader.
+ *  08. Add pcan_chardev_send_frames() and a Tx packet counter.
+ *  09. Add per-reason Rx drop counters, and the gap of reader.
+ *  10. Add per-open message filters, and record which openers accept each message.
+ *  11. Add per-open masks of allowed message types.
+ *  12. Add a status queue for bus status and error events apart from the Rx ring,
+ *      pcan_chardev_push_status(), pcan_chardev_status_of_record() and pcan_chardev_bus_state().
+ *  13. Add per-open wakeup moderation by count of messages and time,
+ *      pcan_chardev_rx_ready() and pcan_chardev_set_rx_wake().
+ *  14. Write messages of a URB into the Rx ring privately, and publish them
+ *      by pcan_chardev_publish_rx_msgs() at a time.
+ *  15. Store timestamps of all PCANFD_OPT_HWTIMESTAMP_* modes into records (ring version 4),
+ *      and add a per-open timestamp mode and pcan_chardev_record_ts_ns().
+ *  16. Store raw ticks and an epoch of conversion into records instead of converted timestamps
+ *      (ring version 5), and publish conversion parameters of the latest epochs in the control block,
+ *      so that pcan_chardev_record_ts_ns() converts them only when read.
+ *  17. Rewrite the entry of an epoch in place when the clock model is steered within it, guard entries
+ *      by a sequence counter, and publish the latest epoch in the control block (ring version 6).
+ *  18. Start a new epoch (never rewritten in place) on every change of the clock model again, keep 512 of them
+ *      in a control block of more than one page, and report records of reused epochs by host time
+ *      with a flag instead of converting them by another epoch (ring version 7).
+ *  19. Add pcan_chardev_can_status() and the overrun flag of the latest error message it takes.
  */
 
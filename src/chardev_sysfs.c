@@ -13,6 +13,7 @@
 #include "versions.h"
 #include "common.h"
 #include "chardev_ioctl.h"
+#include "time_align.h"
 #include "usb_driver.h"
 
 #ifdef __cplusplus
@@ -84,7 +85,7 @@ static DEVICE_ATTR_RO(clock);
 
 static ssize_t bus_state_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
-    return sprintf(buf, "%u\n", PCANFD_ERROR_ACTIVE); /* TODO: More possibilities in future. */
+    return sprintf(buf, "%u\n", pcan_chardev_bus_state((usb_forwarder_t *)dev_get_drvdata(dev)));
 }
 
 static DEVICE_ATTR_RO(bus_state);
@@ -125,9 +126,23 @@ static ssize_t tx_frames_counter_show(struct device *dev, struct device_attribut
 
 static DEVICE_ATTR_RO(tx_frames_counter);
 
+#define DEFINE_RX_DROPS_ATTR(reason)                                                                      \
+static ssize_t rx_drops_##reason##_show(struct device *dev, struct device_attribute *attr, char *buf)     \
+{                                                                                                         \
+    return sprintf(buf, "%lld\n",                                                                         \
+        (long long)atomic64_read(&((usb_forwarder_t *)dev_get_drvdata(dev))->char_dev.rx_drops.reason));  \
+}                                                                                                         \
+                                                                                                          \
+static DEVICE_ATTR_RO(rx_drops_##reason)
+
+DEFINE_RX_DROPS_ATTR(overwritten);
+DEFINE_RX_DROPS_ATTR(no_skb);
+DEFINE_RX_DROPS_ATTR(dev_overruns);
+DEFINE_RX_DROPS_ATTR(decode_errors);
+
 static ssize_t status_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
-    return sprintf(buf, "0x%04x\n", 0/* FIXME: Fetched from somewhere. */);
+    return sprintf(buf, "0x%04x\n", pcan_chardev_can_status((usb_forwarder_t *)dev_get_drvdata(dev)));
 }
 
 static DEVICE_ATTR_RO(status);
@@ -146,6 +161,67 @@ static ssize_t adapter_version_show(struct device *dev, struct device_attribute
 
 static DEVICE_ATTR_RO(adapter_version);
 
+static ssize_t ptp_index_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sprintf(buf, "%d\n", pcan_ptp_index((usb_forwarder_t *)dev_get_drvdata(dev)));
+}
+
+static DEVICE_ATTR_RO(ptp_index);
+
+/* Host time of device time 0 according to the clock model of the adapter, calibration offset included. */
+static ssize_t clock_offset_ns_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    s64 offset_ns, rate_ppb;
+
+    if (pcan_time_align_read_model(&((usb_forwarder_t *)dev_get_drvdata(dev))->time_ref, &offset_ns, &rate_ppb) < 0)
+        return sprintf(buf, "none\n");
+
+    return sprintf(buf, "%lld\n", (long long)offset_ns);
+}
+
+static DEVICE_ATTR_RO(clock_offset_ns);
+
+static ssize_t clock_drift_ppb_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    s64 offset_ns, rate_ppb;
+
+    if (pcan_time_align_read_model(&((usb_forwarder_t *)dev_get_drvdata(dev))->time_ref, &offset_ns, &rate_ppb) < 0)
+        return sprintf(buf, "none\n");
+
+    return sprintf(buf, "%lld\n", (long long)rate_ppb);
+}
+
+static DEVICE_ATTR_RO(clock_drift_ppb);
+
+/* Calibration offset added to timestamps of the adapter, e.g., measured against another adapter on the same bus. */
+static ssize_t ts_offset_ns_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    pcan_clock_t clock;
+
+    pcan_time_ref_snapshot(&((usb_forwarder_t *)dev_get_drvdata(dev))->time_ref, &clock);
+
+    return sprintf(buf, "%lld\n", (long long)clock.offset_ns);
+}
+
+static ssize_t ts_offset_ns_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    s64 offset_ns;
+    int err = kstrtos64(buf, 0, &offset_ns);
+
+    if (err)
+        return err;
+
+    /* Anything beyond a second is not a USB latency at all. */
+    if (offset_ns > NSEC_PER_SEC || offset_ns < -NSEC_PER_SEC)
+        return -ERANGE;
+
+    pcan_time_ref_set_offset(&((usb_forwarder_t *)dev_get_drvdata(dev))->time_ref, offset_ns);
+
+    return count;
+}
+
+static DEVICE_ATTR_RW(ts_offset_ns);
+
 static const struct attribute *S_DEV_ATTRS[] = {
     &dev_attr_hwtype.attr,
     &dev_attr_minor.attr,
@@ -159,9 +235,17 @@ static const struct attribute *S_DEV_ATTRS[] = {
     &dev_attr_write.attr,
     &dev_attr_rx_frames_counter.attr,
     &dev_attr_tx_frames_counter.attr,
+    &dev_attr_rx_drops_overwritten.attr,
+    &dev_attr_rx_drops_no_skb.attr,
+    &dev_attr_rx_drops_dev_overruns.attr,
+    &dev_attr_rx_drops_decode_errors.attr,
     &dev_attr_status.attr,
     &dev_attr_adapter_name.attr,
     &dev_attr_adapter_version.attr,
+    &dev_attr_ptp_index.attr,
+    &dev_attr_clock_offset_ns.attr,
+    &dev_attr_clock_drift_ppb.attr,
+    &dev_attr_ts_offset_ns.attr,
     NULL /* trailing null sentinel*/
 };
 
@@ -184,5 +268,13 @@ const struct attribute** pcan_device_attributes(void)
  *
  * >>> 2024-06-22, Man Hung-Coeng <udc577@126.com>:
  *  01. Fix the compilation error of version_show() on kernel 6.4.0 and above.
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Add attributes rx_drops_* of Rx frames dropped by reason.
+ *  02. Show the real bus state in attribute bus_state.
+ *  03. Add attribute ptp_index telling N of /dev/ptpN of the adapter (-1 if none).
+ *  04. Add attributes clock_offset_ns, clock_drift_ppb and ts_offset_ns of the time alignment service.
+ *  05. Describe clock_offset_ns as a readback of the clock model of the adapter.
+ *  06. Show PCANFD_CANSTATUS_* bits in attribute status.
  */
 
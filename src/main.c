@@ -14,10 +14,20 @@
 #include "common.h"
 #include "klogging.h"
 #include "usb_driver.h"
+#ifdef INNER_TEST
+#include "chardev_operations.h"
+#endif
 
 static __init int pcan_init(void)
 {
-    int ret = usbdrv_register();
+    int ret;
+
+#ifdef INNER_TEST
+    if ((ret = pcan_chardev_rx_ring_selftest()) < 0)
+        return ret;
+#endif
+
+    ret = usbdrv_register();
 
     if (0 == ret)
         pr_notice("Initialized %s-%s.%s for Linux-%#x.\n", __DRVNAME__, DRIVER_VERSION, __VER__, LINUX_VERSION_CODE);
@@ -57,5 +67,8 @@ MODULE_VERSION(DRIVER_VERSION "-" __VER__);
  *
  * >>> 2023-12-18, Man Hung-Coeng <udc577@126.com>:
  *  01. Define module version.
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Run the stress test of chardev Rx ring on loading if INNER_TEST is enabled.
  */
 
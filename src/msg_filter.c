@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * Implementation of message filters of chardev openers.
+ *
+ * Copyright (c) 2026 Man Hung-Coeng <udc577@126.com>
+ * All rights reserved.
+*/
+
+#include "msg_filter.h"
+
+#include <linux/err.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+
+static int compare_intervals(const void *a, const void *b)
+{
+    u32 from_a = ((const pcan_id_interval_t *)a)->from;
+    u32 from_b = ((const pcan_id_interval_t *)b)->from;
+
+    return (from_a < from_b) ? -1 : ((from_a > from_b) ? 1 : 0);
+}
+
+/* Sorts intervals, merges the overlapping or adjacent ones in place, and returns the count left. */
+static u32 merge_intervals(pcan_id_interval_t *intervals, u32 count)
+{
+    u32 merged = 0;
+    u32 i;
+
+    if (0 == count)
+        return 0;
+
+    sort(intervals, count, sizeof(*intervals), compare_intervals, NULL);
+
+    for (i = 1; i < count; ++i)
+    {
+        pcan_id_interval_t *last = &intervals[merged];
+
+        if (intervals[i].from <= last->to || intervals[i].from - last->to == 1)
+        {
+            if (intervals[i].to > last->to)
+                last->to = intervals[i].to;
+        }
+        else
+            intervals[++merged] = intervals[i];
+    }
+
+    return merged + 1;
+}
+
+static bool intervals_contain(const pcan_id_interval_t *intervals, u32 count, u32 id)
+{
+    u32 low = 0;
+    u32 high = count;
+
+    while (low < high)
+    {
+        u32 mid = low + (high - low) / 2;
+
+        if (id < intervals[mid].from)
+            high = mid;
+        else if (id > intervals[mid].to)
+            low = mid + 1;
+        else
+            return true;
+    }
+
+    return false;
+}
+
+pcan_msg_filter_set_t* pcan_msg_filter_set_create(const pcan_msg_filter_set_t *old,
+    const pcanfd_msg_filter_t *added, u32 count)
+{
+    u32 old_count = old ? old->count : 0;
+    u32 total = old_count + count;
+    pcan_msg_filter_set_t *set;
+    u32 i;
+
+    if (count > PCAN_MSG_FILTERS_MAX || total > PCAN_MSG_FILTERS_MAX)
+        return ERR_PTR(-ENOSPC);
+
+    set = kzalloc(sizeof(*set) + (sizeof(pcanfd_msg_filter_t) + sizeof(pcan_id_interval_t) * 2) * total, GFP_KERNEL);
+    if (NULL == set)
+        return ERR_PTR(-ENOMEM);
+
+    if (old_count)
+        memcpy(set->list, old->list, sizeof(pcanfd_msg_filter_t) * old_count);
+
+    if (count)
+        memcpy(&set->list[old_count], added, sizeof(pcanfd_msg_filter_t) * count);
+
+    set->count = total;
+    set->ext = (pcan_id_interval_t *)&set->list[total];
+    set->ext_rtr = &set->ext[total];
+
+    for (i = 0; i < total; ++i)
+    {
+        const pcanfd_msg_filter_t *range = &set->list[i];
+        bool with_rtr = (range->msg_flags & PCANFD_MSG_RTR);
+
+        if (range->id_from > range->id_to)
+            continue;
+
+        if (range->id_from <= CAN_SFF_MASK)
+        {
+            u32 nbits = min_t(u32, range->id_to, CAN_SFF_MASK) - range->id_from + 1;
+
+            bitmap_set(set->std_bits, range->id_from, nbits);
+            if (with_rtr)
+                bitmap_set(set->std_rtr_bits, range->id_from, nbits);
+        }
+
+        if ((range->msg_flags & PCANFD_MSG_EXT) && range->id_from <= CAN_EFF_MASK)
+        {
+            pcan_id_interval_t interval = { .from = range->id_from, .to = min_t(u32, range->id_to, CAN_EFF_MASK) };
+
+            set->ext[set->ext_count++] = interval;
+            if (with_rtr)
+                set->ext_rtr[set->ext_rtr_count++] = interval;
+        }
+    }
+
+    set->ext_count = merge_intervals(set->ext, set->ext_count);
+    set->ext_rtr_count = merge_intervals(set->ext_rtr, set->ext_rtr_count);
+
+    return set;
+}
+
+bool pcan_msg_filter_set_match(const pcan_msg_filter_set_t *set, canid_t can_id)
+{
+    bool is_rtr = (can_id & CAN_RTR_FLAG);
+
+    if (can_id & CAN_ERR_FLAG)
+        return true;
+
+    if (!(can_id & CAN_EFF_FLAG))
+        return test_bit(can_id & CAN_SFF_MASK, is_rtr ? set->std_rtr_bits : set->std_bits);
+
+    return is_rtr ? intervals_contain(set->ext_rtr, set->ext_rtr_count, can_id & CAN_EFF_MASK)
+        : intervals_contain(set->ext, set->ext_count, can_id & CAN_EFF_MASK);
+}
+
+/*
+ * ================
+ *   CHANGE LOG
+ * ================
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Create.
+ */
+
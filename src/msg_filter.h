@@ -0,0 +1,103 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/*
+ * Message filters of chardev openers.
+ *
+ * Copyright (c) 2026 Man Hung-Coeng <udc577@126.com>
+ * All rights reserved.
+*/
+
+#ifndef __MSG_FILTER_H__
+#define __MSG_FILTER_H__
+
+#include <linux/types.h> /* For u32, etc. */
+#include <linux/can.h> /* For canid_t and CAN_*_MASK. */
+#include <linux/can/error.h> /* For CAN_ERR_BUSOFF, etc. */
+#include <linux/bitmap.h> /* For DECLARE_BITMAP(). */
+#include <linux/rcupdate.h> /* For struct rcu_head. */
+
+#include "chardev_ioctl.h" /* For pcanfd_msg_filter_t and PCANFD_ALLOWED_MSG_*. */
+
+/* Upper limit of ID ranges added by an opener. */
+#define PCAN_MSG_FILTERS_MAX                    1024
+
+typedef struct pcan_id_interval
+{
+    u32 from;
+    u32 to;
+} pcan_id_interval_t;
+
+/*
+ * Filter set of an opener, immutable once created, and replaced as a whole under RCU.
+ *
+ * As PEAK's driver does, a frame passes if its ID is in any range whose msg_flags allow its type:
+ * ranges without PCANFD_MSG_RTR reject remote frames, ranges without PCANFD_MSG_EXT reject
+ * extended frames, and error frames always pass. To match a frame in constant or logarithmic time,
+ * ranges are turned into a bitmap for the 11-bit space, and sorted disjoint intervals for the 29-bit one.
+ */
+typedef struct pcan_msg_filter_set
+{
+    struct rcu_head rcu;
+    u32 count; /* count of ranges added by user, i.e., items of list */
+    u32 ext_count; /* count of intervals of ext */
+    u32 ext_rtr_count; /* count of intervals of ext_rtr */
+    DECLARE_BITMAP(std_bits, CAN_SFF_MASK + 1); /* 11-bit IDs of data frames that pass */
+    DECLARE_BITMAP(std_rtr_bits, CAN_SFF_MASK + 1); /* 11-bit IDs of remote frames that pass */
+    pcan_id_interval_t *ext; /* 29-bit IDs of data frames that pass */
+    pcan_id_interval_t *ext_rtr; /* 29-bit IDs of remote frames that pass */
+    pcanfd_msg_filter_t list[]; /* ranges as added by user, followed by memory of ext and ext_rtr */
+} pcan_msg_filter_set_t;
+
+/*
+ * Creates a filter set with ranges of old (if not NULL) plus count ranges of added.
+ * Returns an ERR_PTR() on failure, e.g.: -ENOSPC if there would be more than PCAN_MSG_FILTERS_MAX ranges.
+ */
+pcan_msg_filter_set_t* pcan_msg_filter_set_create(const pcan_msg_filter_set_t *old,
+    const pcanfd_msg_filter_t *added, u32 count);
+
+/* Returns true if the frame of can_id passes the filter set, which must not be NULL. */
+bool pcan_msg_filter_set_match(const pcan_msg_filter_set_t *set, canid_t can_id);
+
+/* Returns true if the frame of can_id is an error frame reporting bus-off or controller problems. */
+static inline bool pcan_msg_is_status(canid_t can_id)
+{
+    return (can_id & CAN_ERR_FLAG) && (can_id & (CAN_ERR_BUSOFF | CAN_ERR_CRTL | CAN_ERR_RESTARTED));
+}
+
+/*
+ * Returns true if the frame of can_id is of a type allowed by allowed_msgs (PCANFD_ALLOWED_MSG_*):
+ *  - an error frame of bus-off or controller problems needs PCANFD_ALLOWED_MSG_STATUS,
+ *  - any other error frame needs PCANFD_ALLOWED_MSG_ERROR,
+ *  - a data or remote frame needs PCANFD_ALLOWED_MSG_CAN, plus PCANFD_ALLOWED_MSG_RTR if it's remote,
+ *    and PCANFD_ALLOWED_MSG_EXT if it's extended.
+ */
+static inline bool pcan_msg_is_allowed(u32 allowed_msgs, canid_t can_id)
+{
+    u32 needed = PCANFD_ALLOWED_MSG_CAN;
+
+    if (can_id & CAN_ERR_FLAG)
+        needed = pcan_msg_is_status(can_id) ? PCANFD_ALLOWED_MSG_STATUS : PCANFD_ALLOWED_MSG_ERROR;
+    else
+    {
+        if (can_id & CAN_RTR_FLAG)
+            needed |= PCANFD_ALLOWED_MSG_RTR;
+        if (can_id & CAN_EFF_FLAG)
+            needed |= PCANFD_ALLOWED_MSG_EXT;
+    }
+
+    return (allowed_msgs & needed) == needed;
+}
+
+#endif /* #ifndef __MSG_FILTER_H__ */
+
+/*
+ * ================
+ *   CHANGE LOG
+ * ================
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Create.
+ *  02. Add pcan_msg_is_allowed().
+ *  03. Add pcan_msg_is_status().
+ */
+
@@ -125,6 +125,8 @@ static void usb_write_bulk_callback(struct urb *urb)
     usb_forwarder_t *forwarder = ctx ? ctx->forwarder : NULL;
     struct net_device *netdev = forwarder ? forwarder->net_dev : NULL;
     int tx_bytes = 0;
+    u8 tx_frames;
+    u8 i;
 
     if (NULL == ctx)
         return;
@@ -153,15 +155,20 @@ static void usb_write_bulk_callback(struct urb *urb)
         break;
     }
 
-    /* should always release echo skb and corresponding context */
-    tx_bytes = evol_can_get_echo_skb(netdev, ctx->echo_index - 1, NULL);
+    /* should always release echo skbs and corresponding context */
+    for (i = 0; i < ctx->frame_count; ++i)
+    {
+        tx_bytes += evol_can_get_echo_skb(netdev, PCAN_USB_ECHO_SLOT(ctx, i), NULL);
+    }
+    tx_frames = ctx->frame_count;
+    ctx->frame_count = 0;
     ctx->echo_index = 0;
 
     if (!urb->status)
     {
         /* transmission complete */
         atomic_inc(&forwarder->shared_tx_counter);
-        ++netdev->stats.tx_packets;
+        netdev->stats.tx_packets += tx_frames;
         netdev->stats.tx_bytes += tx_bytes;
 
         /* do wakeup tx queue in case of success only */
@@ -186,7 +193,7 @@ static int start_can_interface(struct net_device *netdev)
     if (stage > PCAN_USB_STAGE_ONE_STARTED)
         goto lbl_start_ok;
 
-    memset(&forwarder->time_ref, 0, sizeof(forwarder->time_ref));
+    pcan_time_ref_reset(&forwarder->time_ref);
     ktime_get_real_ts64(&forwarder->bus_up_time);
 
     err = (dev_revision > 3) ? pcan_cmd_set_silent(forwarder, forwarder->can.ctrlmode & CAN_CTRLMODE_LISTENONLY) : 0;
@@ -199,9 +206,7 @@ static int start_can_interface(struct net_device *netdev)
 
 lbl_start_ok:
 
-    forwarder->can.state = CAN_STATE_ERROR_ACTIVE;
-
-    return 0;
+    return 0; /* Bus state is set by usbdrv_reset_bus(), and kept as is if chardev has turned bus on. */
 
 lbl_start_failed:
 
@@ -228,35 +233,109 @@ static int pcan_net_open(struct net_device *netdev)
         return err;
     }
 
+    napi_enable(&((usb_forwarder_t *)netdev_priv(netdev))->napi);
     netif_start_queue(netdev);
 
     return 0;
 }
 
+static void discard_net_tx_context(usb_forwarder_t *forwarder, pcan_tx_urb_context_t *ctx)
+{
+    u8 i;
+
+    for (i = 0; i < ctx->frame_count; ++i)
+    {
+        evol_can_free_echo_skb(forwarder->net_dev, PCAN_USB_ECHO_SLOT(ctx, i), NULL);
+    }
+    forwarder->net_dev->stats.tx_dropped += ctx->frame_count;
+    ctx->frame_count = 0;
+    ctx->echo_index = 0;
+}
+
 static int pcan_net_stop(struct net_device *netdev)
 {
     usb_forwarder_t *forwarder = (usb_forwarder_t *)netdev_priv(netdev);
     int stage = atomic_dec_return(&forwarder->stage);
 
     netif_stop_queue(netdev);
+    napi_disable(&forwarder->napi);
+    netdev->stats.rx_dropped += skb_queue_len(&forwarder->net_rx_queue);
+    skb_queue_purge(&forwarder->net_rx_queue);
+
+    if (forwarder->net_tx_filling) /* Should not happen since the stack never leaves xmit_more pending. */
+    {
+        discard_net_tx_context(forwarder, forwarder->net_tx_filling);
+        forwarder->net_tx_filling = NULL;
+    }
 
-    close_candev(netdev);
-    forwarder->can.state = CAN_STATE_STOPPED;
+    close_candev(netdev); /* Bus state is left to usbdrv_reset_bus(), since chardev might be still using it. */
 
     return (stage < PCAN_USB_STAGE_ONE_STARTED) ? usbdrv_reset_bus(forwarder, /* is_on = */0) : 0;
 }
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0)
+#define xmit_more_pending(skb)          netdev_xmit_more()
+#else
+#define xmit_more_pending(skb)          ((skb)->xmit_more)
+#endif
+
+static void submit_net_tx_context(usb_forwarder_t *forwarder, pcan_tx_urb_context_t *ctx)
+{
+    struct net_device *netdev = forwarder->net_dev;
+    struct urb *urb = ctx->urb;
+    int err;
+
+    forwarder->net_tx_filling = NULL;
+    pcan_encode_tx_end(netdev, urb->transfer_buffer);
+
+    usb_anchor_urb(urb, &forwarder->anchor_tx_submitted);
+    atomic_inc(&forwarder->active_tx_urbs);
+
+    err = usb_submit_urb(urb, GFP_ATOMIC);
+    if (err)
+    {
+        usb_unanchor_urb(urb);
+        atomic_dec(&forwarder->active_tx_urbs);
+
+        switch (err)
+        {
+        case -ENODEV:
+            netif_device_detach(netdev); /* FIXME: pcan_net_dev_close() ?? */
+            break;
+
+        default:
+            netdev_warn_ratelimited_v(netdev, "tx urb submitting failed err=%d\n", err);
+            break;
+
+        case -ENOENT: /* cable unplugged */
+            break;
+        }
+
+        discard_net_tx_context(forwarder, ctx);
+    }
+    else
+    {
+        evol_netif_trans_update(netdev);
+
+        /* slow down tx path */
+        if (atomic_read(&forwarder->active_tx_urbs) >= PCAN_USB_MAX_TX_URBS)
+            netif_stop_queue(netdev);
+    }
+}
+
+/*
+ * Frames are packed into the Tx URB being filled (forwarder->net_tx_filling),
+ * which is submitted once it is full, or the stack has no more frames to send right now.
+ */
 static netdev_tx_t pcan_net_start_transmit(struct sk_buff *skb, struct net_device *netdev)
 {
     usb_forwarder_t *forwarder = (usb_forwarder_t *)netdev_priv(netdev);
-    pcan_tx_urb_context_t *ctx = NULL;
+    pcan_tx_urb_context_t *ctx = forwarder->net_tx_filling;
     struct net_device_stats *stats = &netdev->stats;
     struct can_frame *frame = (struct can_frame *)skb->data;
-    struct urb *urb;
-    u8 *obuf;
+    bool more = xmit_more_pending(skb);
     int i;
     int err;
-    size_t size = PCAN_USB_TX_BUFFER_SIZE;
 
     if (forwarder->can.ctrlmode & CAN_CTRLMODE_LISTENONLY)
     {
@@ -266,27 +345,38 @@ static netdev_tx_t pcan_net_start_transmit(struct sk_buff *skb, struct net_devic
         kfree_skb(skb);
         ++stats->tx_dropped;
 
-        return NETDEV_TX_OK;
+        goto lbl_xmit_end;
     }
 
     if (can_dropped_invalid_skb(netdev, skb))
-        return NETDEV_TX_OK;
+        goto lbl_xmit_end;
 
-    for (i = 0; i < PCAN_USB_MAX_TX_URBS; ++i)
+    if (ctx && ctx->buf_len + pcan_encoded_frame_len(frame) > PCAN_USB_TX_BUFFER_SIZE - 1)
     {
-        if (!forwarder->tx_contexts[i].echo_index)
-        {
-            ctx = forwarder->tx_contexts + i;
-            break;
-        }
+        submit_net_tx_context(forwarder, ctx);
+        ctx = NULL;
     }
+
     if (!ctx)
-        return NETDEV_TX_BUSY; /* should not occur except during restart */
+    {
+        for (i = 0; i < PCAN_USB_MAX_TX_URBS; ++i)
+        {
+            if (!forwarder->tx_contexts[i].echo_index)
+            {
+                ctx = forwarder->tx_contexts + i;
+                break;
+            }
+        }
+        if (!ctx)
+            return NETDEV_TX_BUSY; /* should not occur except during restart */
 
-    urb = ctx->urb;
-    obuf = urb->transfer_buffer;
+        ctx->echo_index = i + 1;
+        ctx->frame_count = 0;
+        pcan_encode_tx_begin(ctx->urb->transfer_buffer, &ctx->buf_len);
+        forwarder->net_tx_filling = ctx;
+    }
 
-    err = pcan_encode_frame_to_buf(netdev, frame, obuf, &size);
+    err = pcan_encode_frame_to_buf(frame, ctx->urb->transfer_buffer, &ctx->buf_len);
     if (err)
     {
         netdev_err_ratelimited_v(netdev, "packet dropped\n");
@@ -294,51 +384,96 @@ static netdev_tx_t pcan_net_start_transmit(struct sk_buff *skb, struct net_devic
         dev_kfree_skb(skb);
         ++stats->tx_dropped;
 
-        return NETDEV_TX_OK;
+        goto lbl_xmit_end;
     }
 
-    ctx->echo_index = i + 1;
+    evol_can_put_echo_skb(skb, netdev, PCAN_USB_ECHO_SLOT(ctx, ctx->frame_count), 0);
+    ++ctx->frame_count;
 
-    usb_anchor_urb(urb, &forwarder->anchor_tx_submitted);
-    evol_can_put_echo_skb(skb, netdev, ctx->echo_index - 1, 0);
-    atomic_inc(&forwarder->active_tx_urbs);
+lbl_xmit_end:
 
-    err = usb_submit_urb(urb, GFP_ATOMIC);
-    if (err)
+    ctx = forwarder->net_tx_filling;
+    if (ctx && (!more || ctx->frame_count >= PCAN_USB_MAX_FRAMES_PER_URB))
     {
-        evol_can_free_echo_skb(netdev, ctx->echo_index - 1, NULL);
+        if (ctx->frame_count)
+            submit_net_tx_context(forwarder, ctx);
+        else /* Nothing packed due to errors above. */
+        {
+            forwarder->net_tx_filling = NULL;
+            ctx->echo_index = 0;
+        }
+    }
 
-        usb_unanchor_urb(urb);
+    return NETDEV_TX_OK;
+}
 
-        /* FIXME: this context is not used in fact */
-        ctx->echo_index = 0;
+/* Upper limit of skbs waiting for NAPI, about a second of full bus load at 1 Mbit/s. */
+#define NET_RX_QUEUE_MAX                8192
 
-        atomic_dec(&forwarder->active_tx_urbs);
+static int pcan_net_rx_poll(struct napi_struct *napi, int budget)
+{
+    usb_forwarder_t *forwarder = container_of(napi, usb_forwarder_t, napi);
+    struct sk_buff_head *queue = &forwarder->net_rx_queue;
+    struct sk_buff_head batch;
+    struct sk_buff *skb;
+    unsigned long flags;
+    int done = 0;
 
-        switch (err)
-        {
-        case -ENODEV:
-            netif_device_detach(netdev); /* FIXME: pcan_net_dev_close() ?? */
-            break;
+    __skb_queue_head_init(&batch);
 
-        default:
-            netdev_warn_ratelimited_v(netdev, "tx urb submitting failed err=%d\n", err);
-            fallthrough;
+    spin_lock_irqsave(&queue->lock, flags);
+    while (done < budget && NULL != (skb = __skb_dequeue(queue)))
+    {
+        __skb_queue_tail(&batch, skb);
+        ++done;
+    }
+    spin_unlock_irqrestore(&queue->lock, flags);
 
-        case -ENOENT:
-            ++stats->tx_dropped; /* cable unplugged */
-        }
+    while (NULL != (skb = __skb_dequeue(&batch)))
+    {
+        netif_receive_skb(skb);
     }
+
+    if (done < budget && napi_complete_done(napi, done) && !skb_queue_empty(queue))
+        napi_schedule(napi);
+
+    return done;
+}
+
+void pcan_net_init_rx(struct net_device *netdev)
+{
+    usb_forwarder_t *forwarder = (usb_forwarder_t *)netdev_priv(netdev);
+
+    skb_queue_head_init(&forwarder->net_rx_queue);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
+    netif_napi_add(netdev, &forwarder->napi, pcan_net_rx_poll);
+#else
+    netif_napi_add(netdev, &forwarder->napi, pcan_net_rx_poll, NAPI_POLL_WEIGHT);
+#endif
+}
+
+void pcan_net_queue_rx_skbs(struct net_device *netdev, struct sk_buff_head *skbs)
+{
+    usb_forwarder_t *forwarder = (usb_forwarder_t *)netdev_priv(netdev);
+    struct sk_buff_head *queue = &forwarder->net_rx_queue;
+    unsigned long flags;
+    u32 dropped = 0;
+
+    spin_lock_irqsave(&queue->lock, flags);
+    if (skb_queue_len(queue) + skb_queue_len(skbs) <= NET_RX_QUEUE_MAX)
+        skb_queue_splice_tail_init(skbs, queue);
     else
-    {
-        evol_netif_trans_update(netdev);
+        dropped = skb_queue_len(skbs);
+    spin_unlock_irqrestore(&queue->lock, flags);
 
-        /* slow down tx path */
-        if (atomic_read(&forwarder->active_tx_urbs) >= PCAN_USB_MAX_TX_URBS)
-            netif_stop_queue(netdev);
+    if (dropped)
+    {
+        netdev->stats.rx_dropped += dropped;
+        __skb_queue_purge(skbs);
+        netdev_warn_ratelimited_v(netdev, "Rx queue full, %u frames dropped\n", dropped);
     }
-
-    return NETDEV_TX_OK;
+    else
+        napi_schedule(&forwarder->napi);
 }
 
 void pcan_net_set_ops(struct net_device *netdev)
@@ -412,5 +547,14 @@ void pcan_net_set_ops(struct net_device *netdev)
  *
  * >>> 2023-12-23, Man Hung-Coeng <udc577@126.com>:
  *  01. Mark the CAN bus active time point in open function.
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Pack as many frames as possible into a Tx URB
+ *      while the stack indicates more frames are coming (xmit_more).
+ *  02. Leave bus state to usbdrv_reset_bus(), so that opening or closing netdev
+ *      does not overwrite the state while chardev is using the bus.
+ *  03. Deliver Rx frames to the stack through NAPI in batches,
+ *      with pcan_net_init_rx() and pcan_net_queue_rx_skbs().
+ *  04. Reset the clock model through pcan_time_ref_reset() in start_can_interface().
  */
 
@@ -13,6 +13,7 @@
 struct can_clock;
 struct can_bittiming_const;
 struct net_device;
+struct sk_buff_head;
 enum can_mode;
 
 const struct can_clock* get_fixed_can_clock(void);
@@ -32,6 +33,15 @@ int pcan_net_set_can_mode(struct net_device *netdev, enum can_mode mode);
 
 void pcan_net_set_ops(struct net_device *netdev);
 
+/* Sets up the NAPI instance and Rx queue of netdev, called once before registering netdev. */
+void pcan_net_init_rx(struct net_device *netdev);
+
+/*
+ * Called by decoder once per URB, moves skbs decoded into the Rx queue of netdev,
+ * and schedules NAPI to hand them over to the stack in batches.
+ */
+void pcan_net_queue_rx_skbs(struct net_device *netdev, struct sk_buff_head *skbs);
+
 #endif /* #ifndef __NETDEV_OPERATIONS_H__ */
 
 /*
@@ -59,5 +69,8 @@ void pcan_net_set_ops(struct net_device *netdev);
  *
  * >>> 2023-12-18, Man Hung-Coeng <udc577@126.com>:
  *  01. Rename this file from netdev_interfaces.h to netdev_operations.h.
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Add pcan_net_init_rx() and pcan_net_queue_rx_skbs().
  */
 
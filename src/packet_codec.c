@@ -11,12 +11,18 @@
 
 #include <linux/ktime.h>
 #include <linux/netdevice.h>
+#ifdef INNER_TEST
+#include <linux/timex.h> /* For get_cycles(). */
+#include <linux/math64.h> /* For div64_u64(). */
+#endif
 #include <linux/can/dev.h>
 
 #include "common.h"
 #include "klogging.h"
 #include "can_commands.h"
+#include "netdev_operations.h"
 #include "usb_driver.h"
+#include "time_align.h"
 
 #define PCAN_USB_MSG_HEADER_LEN		        2
 
@@ -49,6 +55,22 @@
 #define PCAN_USB_TS_USED_BITS               16
 #define PCAN_USB_TS_CALIBRATION             24575
 
+/* Nominal tick length in nanoseconds, in 32.32 fixed point. */
+#define PCAN_USB_NS_PER_TICK_Q32            (((u64)PCAN_USB_TS_US_PER_TICK * NSEC_PER_USEC) << (32 - PCAN_USB_TS_DIV_SHIFTER))
+
+/*
+ * Time references are filtered in windows of about 1.4 s, and only the one of the least error
+ * (i.e., of the least USB latency) in each window steers the clock model,
+ * whose slope corrects 1/4 of that error in the next window, and 1/16 of it for good as frequency error.
+ */
+#define PCAN_USB_CLOCK_WINDOW_TICKS         (1 << 15)
+#define PCAN_USB_CLOCK_PHASE_GAIN           4
+#define PCAN_USB_CLOCK_FREQ_GAIN            16
+/* Crystals are within 100 ppm, so anything beyond it is a broken estimate. */
+#define PCAN_USB_CLOCK_MAX_PPB              500000
+/* The model is re-anchored at once if it is so far away, e.g., after the host was suspended. */
+#define PCAN_USB_CLOCK_RESYNC_NS            (5 * NSEC_PER_MSEC)
+
 /* PCAN-USB messages record types */
 #define PCAN_USB_REC_ERROR		            1
 #define PCAN_USB_REC_ANALOG		            2
@@ -66,69 +88,336 @@ typedef struct msg_context
     u8 rec_idx;
     u8 rec_data_idx;
     struct net_device *netdev;
+    ktime_t host_time; /* when decoding of the URB began */
+    pcan_clock_t clock; /* snapshot of the clock model, refreshed by each time reference */
+    struct sk_buff_head rx_skbs; /* skbs for netdev, sorted by hardware timestamp */
 } msg_context_t;
 
-int pcan_encode_frame_to_buf(const struct net_device *dev, const struct can_frame *frame, u8 *obuf, size_t *size)
+/*
+ * Records of a URB are almost always in order already, so searching from the tail takes a step mostly.
+ * Those without hardware timestamps are appended as they come.
+ */
+static void queue_rx_skb(msg_context_t *ctx, struct sk_buff *skb)
 {
-    usb_forwarder_t *forwarder = (usb_forwarder_t *)netdev_priv(dev);
+    ktime_t hwtstamp = skb_hwtstamps(skb)->hwtstamp;
+    struct sk_buff *prev;
+
+    if (0 == hwtstamp)
+    {
+        __skb_queue_tail(&ctx->rx_skbs, skb);
+        return;
+    }
 
+    skb_queue_reverse_walk(&ctx->rx_skbs, prev)
+    {
+        if (skb_hwtstamps(prev)->hwtstamp <= hwtstamp)
+        {
+            __skb_queue_after(&ctx->rx_skbs, prev, skb);
+            return;
+        }
+    }
+
+    __skb_queue_head(&ctx->rx_skbs, skb);
+}
+
+void pcan_encode_tx_begin(u8 *obuf, size_t *len)
+{
     /* header */
-    *obuf++ = 2;
-    *obuf++ = 1;
+    obuf[0] = 2;
+    obuf[1] = 0; /* count of records, increased by pcan_encode_frame_to_buf() */
+
+    *len = PCAN_USB_MSG_HEADER_LEN;
+}
+
+int pcan_encode_frame_to_buf(const struct can_frame *frame, u8 *obuf, size_t *len)
+{
+    u8 *ptr = obuf + *len;
+
+    if (*len + pcan_encoded_frame_len(frame) > PCAN_USB_TX_BUFFER_SIZE - 1) /* The last byte is reserved. */
+        return -ENOSPC;
 
     /* status/len */
-    *obuf = frame->can_dlc;
+    *ptr = frame->can_dlc;
     if (frame->can_id & CAN_RTR_FLAG)
-        *obuf |= PCAN_USB_STATUSLEN_RTR;
+        *ptr |= PCAN_USB_STATUSLEN_RTR;
 
     /* can id */
     if (frame->can_id & CAN_EFF_FLAG)
     {
         __le32 tmp32 = cpu_to_le32((frame->can_id & CAN_ERR_MASK) << 3);
 
-        *obuf |= PCAN_USB_STATUSLEN_EXT_ID;
-        memcpy(++obuf, &tmp32, sizeof(tmp32));
-        obuf += sizeof(tmp32);
+        *ptr |= PCAN_USB_STATUSLEN_EXT_ID;
+        memcpy(++ptr, &tmp32, sizeof(tmp32));
+        ptr += sizeof(tmp32);
     }
     else
     {
         __le16 tmp16 = cpu_to_le16((frame->can_id & CAN_ERR_MASK) << 5);
 
-        memcpy(++obuf, &tmp16, sizeof(tmp16));
-        obuf += sizeof(tmp16);
+        memcpy(++ptr, &tmp16, sizeof(tmp16));
+        ptr += sizeof(tmp16);
     }
 
     /* can data */
     if (!(frame->can_id & CAN_RTR_FLAG))
     {
-        memcpy(obuf, frame->data, frame->can_dlc);
-        obuf += frame->can_dlc;
+        memcpy(ptr, frame->data, frame->can_dlc);
+        ptr += frame->can_dlc;
+    }
+
+    ++obuf[1];
+    *len = ptr - obuf;
+
+    return 0;
+}
+
+void pcan_encode_tx_end(const struct net_device *dev, u8 *obuf)
+{
+    usb_forwarder_t *forwarder = (usb_forwarder_t *)netdev_priv(dev);
+
+    obuf[PCAN_USB_TX_BUFFER_SIZE - 1] = (u8)(atomic_read(&forwarder->shared_tx_counter) & 0xff); /* FIXME: What does it mean? */
+}
+
+u64 pcan_clock_ticks_to_us(u64 ticks)
+{
+    return mul_u64_u64_shr(ticks, PCAN_USB_TS_US_PER_TICK, PCAN_USB_TS_DIV_SHIFTER);
+}
+
+ktime_t pcan_ticks_to_host_time(ktime_t base_host, u64 base_ticks, u64 ns_per_tick_q32, u64 ticks)
+{
+    if (ticks >= base_ticks)
+        return ktime_add_ns(base_host, mul_u64_u64_shr(ticks - base_ticks, ns_per_tick_q32, 32));
+
+    return ktime_sub_ns(base_host, mul_u64_u64_shr(base_ticks - ticks, ns_per_tick_q32, 32));
+}
+
+static inline ktime_t clock_model_time(const pcan_clock_t *clock, u64 ticks)
+{
+    return pcan_ticks_to_host_time(clock->anchor_host, clock->anchor_ticks, clock->ns_per_tick_q32, ticks);
+}
+
+/* Extends a 16-bit device timestamp to 64 bits, which may be a little earlier than the last reference too. */
+static inline u64 extend_ticks(const pcan_clock_t *clock, u16 ts16)
+{
+    s16 delta = (s16)(ts16 - clock->ts16);
+
+    return (delta < 0 && (u64)-delta > clock->ticks) ? 0 : clock->ticks + delta;
+}
+
+/* Only extends the device timestamp, and leaves conversions to consumers, some of which might drop the event. */
+static void fill_timestamps(const pcan_clock_t *clock, u16 ts16, ktime_t host_time, pcan_timestamps_t *ts)
+{
+    ts->host = host_time;
+    ts->raw = ts16;
+
+    if (clock->tick_count)
+    {
+        ts->ticks = extend_ticks(clock, ts16);
+        ts->clock = clock;
     }
+    else
+    {
+        ts->ticks = 0;
+        ts->clock = NULL;
+    }
+}
 
-    /* FIXME: Need to update value of size? */
-    obuf[*size - 1] = (u8)(atomic_read(&forwarder->shared_tx_counter) & 0xff); /* FIXME: What does it mean? */
+/* For events without device timestamps. */
+static void fill_host_timestamps(const pcan_clock_t *clock, u16 ts16, ktime_t host_time, pcan_timestamps_t *ts)
+{
+    ts->host = host_time;
+    ts->ticks = clock->ticks;
+    ts->clock = NULL;
+    ts->raw = ts16;
+}
+
+/* Hardware timestamp of netdev skbs, i.e., the cooked one. */
+static inline ktime_t cooked_timestamp(const pcan_timestamps_t *ts)
+{
+    return ts->clock ? ktime_add(clock_model_time(ts->clock, ts->ticks), ns_to_ktime(ts->clock->offset_ns)) : ts->host;
+}
+
+void pcan_clock_to_ts_epoch(const pcan_clock_t *clock, pcan_rx_ts_epoch_t *params)
+{
+    params->cooked_ticks = clock->anchor_ticks;
+    params->cooked_host_ns = ktime_to_ns(clock->anchor_host) + clock->offset_ns;
+    params->cooked_ns_per_tick_q32 = clock->ns_per_tick_q32;
+
+    /* The nominal line from the first reference drifts apart from those of other adapters. */
+    if (pcan_time_align_enabled())
+    {
+        params->hw_ticks = params->cooked_ticks;
+        params->hw_host_ns = params->cooked_host_ns;
+        params->hw_ns_per_tick_q32 = params->cooked_ns_per_tick_q32;
+    }
+    else
+    {
+        params->hw_ticks = clock->ticks_0;
+        params->hw_host_ns = ktime_to_ns(clock->host_0) + clock->offset_ns;
+        params->hw_ns_per_tick_q32 = PCAN_USB_NS_PER_TICK_Q32;
+    }
+}
+
+void pcan_time_ref_reset(pcan_time_ref_t *time_ref)
+{
+    unsigned long flags;
+    s64 offset_ns;
+    u32 epoch;
+
+    write_seqlock_irqsave(&time_ref->lock, flags);
+    epoch = time_ref->clock.epoch; /* Never reused, or records of the last bus on would be converted by the next. */
+    offset_ns = time_ref->clock.offset_ns; /* Set by user, not learned. */
+    memset(&time_ref->clock, 0, sizeof(time_ref->clock));
+    time_ref->clock.epoch = epoch;
+    time_ref->clock.offset_ns = offset_ns;
+    time_ref->window_ticks = 0;
+    time_ref->window_min_err = 0;
+    time_ref->window_refs = 0;
+    write_sequnlock_irqrestore(&time_ref->lock, flags);
+}
+
+void pcan_time_ref_init(pcan_time_ref_t *time_ref)
+{
+    seqlock_init(&time_ref->lock);
+    INIT_LIST_HEAD(&time_ref->align_node);
+    time_ref->clock.epoch = 0;
+    time_ref->clock.offset_ns = 0;
+    pcan_time_ref_reset(time_ref);
+}
+
+void pcan_time_ref_snapshot(pcan_time_ref_t *time_ref, pcan_clock_t *clock)
+{
+    unsigned int seq;
+
+    do
+    {
+        seq = read_seqbegin(&time_ref->lock);
+        *clock = time_ref->clock;
+    } while (read_seqretry(&time_ref->lock, seq));
+}
+
+int pcan_time_ref_dev_ns(pcan_time_ref_t *time_ref, ktime_t host_time, u64 *dev_ns)
+{
+    pcan_clock_t clock;
+    s64 host_delta;
+
+    pcan_time_ref_snapshot(time_ref, &clock);
+    if (0 == clock.tick_count)
+        return -ENODATA;
+
+    /* The first order inverse of the slope is good enough, since the anchor is a few seconds away at most. */
+    host_delta = ktime_to_ns(ktime_sub(host_time, clock.anchor_host));
+    *dev_ns = mul_u64_u64_shr(clock.anchor_ticks, PCAN_USB_NS_PER_TICK_Q32, 32)
+        + host_delta - div_s64(host_delta * clock.slope_ppb, NSEC_PER_SEC);
 
     return 0;
 }
 
-void compute_kernel_time(const pcan_time_ref_t *time_ref, u32 timestamp, ktime_t *kernel_time)
+/* For every change of conversion, since records converted later must keep the parameters of their own epochs. */
+static inline void next_clock_epoch(pcan_clock_t *clock)
+{
+    if (0 == ++clock->epoch)
+        clock->epoch = 1;
+}
+
+static void set_clock_slope(pcan_clock_t *clock, s64 ppb)
+{
+    ppb = clamp_t(s64, ppb, -PCAN_USB_CLOCK_MAX_PPB, PCAN_USB_CLOCK_MAX_PPB);
+    clock->slope_ppb = ppb;
+    clock->ns_per_tick_q32 = PCAN_USB_NS_PER_TICK_Q32 + div_s64((s64)(PCAN_USB_NS_PER_TICK_Q32 / 1000) * ppb, 1000000);
+}
+
+void pcan_time_ref_new_epoch(pcan_time_ref_t *time_ref)
 {
-    if (ktime_to_ns(time_ref->tv_host) > 0)
+    unsigned long flags;
+
+    write_seqlock_irqsave(&time_ref->lock, flags);
+    next_clock_epoch(&time_ref->clock);
+    write_sequnlock_irqrestore(&time_ref->lock, flags);
+}
+
+void pcan_time_ref_set_offset(pcan_time_ref_t *time_ref, s64 offset_ns)
+{
+    unsigned long flags;
+
+    write_seqlock_irqsave(&time_ref->lock, flags);
+    time_ref->clock.offset_ns = offset_ns;
+    next_clock_epoch(&time_ref->clock);
+    write_sequnlock_irqrestore(&time_ref->lock, flags);
+}
+
+/* Steers the clock model by a time reference received at host_time, must be called with lock held. */
+static void filter_time_reference(pcan_time_ref_t *time_ref, ktime_t host_time)
+{
+    pcan_clock_t *clock = &time_ref->clock;
+    s64 err = ktime_to_ns(ktime_sub(host_time, clock_model_time(clock, clock->ticks)));
+    s64 window_ns;
+    s64 err_ppb;
+
+    if (err > PCAN_USB_CLOCK_RESYNC_NS || err < -PCAN_USB_CLOCK_RESYNC_NS)
     {
-        u64 delta_us = timestamp - time_ref->ts_dev_2;
+        clock->anchor_ticks = clock->ticks;
+        clock->anchor_host = host_time;
+        set_clock_slope(clock, clock->freq_ppb);
+        next_clock_epoch(clock);
+        time_ref->window_ticks = clock->ticks;
+        time_ref->window_refs = 0;
+
+        return;
+    }
+
+    if (0 == time_ref->window_refs++ || err < time_ref->window_min_err)
+        time_ref->window_min_err = err;
 
-        if (timestamp < time_ref->ts_dev_2)
-            delta_us &= (1 << PCAN_USB_TS_USED_BITS) - 1;
+    if (clock->ticks - time_ref->window_ticks < PCAN_USB_CLOCK_WINDOW_TICKS)
+        return;
 
-        delta_us += time_ref->ts_total;
+    window_ns = mul_u64_u64_shr(clock->ticks - time_ref->window_ticks, PCAN_USB_NS_PER_TICK_Q32, 32);
+    err_ppb = div64_s64(time_ref->window_min_err * NSEC_PER_SEC, window_ns);
+    clock->freq_ppb = clamp_t(s64, clock->freq_ppb + err_ppb / PCAN_USB_CLOCK_FREQ_GAIN,
+        -PCAN_USB_CLOCK_MAX_PPB, PCAN_USB_CLOCK_MAX_PPB);
 
-        delta_us *= PCAN_USB_TS_US_PER_TICK;
-        delta_us >>= PCAN_USB_TS_DIV_SHIFTER;
+    /* Re-anchored on the current line, so that only the slope changes. */
+    clock->anchor_host = clock_model_time(clock, clock->ticks);
+    clock->anchor_ticks = clock->ticks;
+    set_clock_slope(clock, clock->freq_ppb + err_ppb / PCAN_USB_CLOCK_PHASE_GAIN);
+    next_clock_epoch(clock); /* The new slope, phase slew included, serves no record received before. */
 
-        *kernel_time = ktime_add_us(time_ref->tv_host_0, delta_us);
+    time_ref->window_ticks = clock->ticks;
+    time_ref->window_refs = 0;
+}
+
+/* Called by decoder only, and with_host_time tells whether host_time is a fair sample of the reference. */
+static void update_time_reference(pcan_time_ref_t *time_ref, u16 ts16, bool with_host_time, ktime_t host_time,
+    pcan_clock_t *snapshot)
+{
+    pcan_clock_t *clock = &time_ref->clock;
+
+    write_seqlock(&time_ref->lock);
+
+    if (0 == clock->tick_count)
+    {
+        clock->ts16 = ts16;
+        clock->ticks = clock->ticks_0 = clock->anchor_ticks = ts16;
+        clock->host_0 = clock->anchor_host = host_time;
+        clock->ns_per_tick_q32 = PCAN_USB_NS_PER_TICK_Q32;
+        clock->slope_ppb = 0;
+        clock->freq_ppb = 0;
+        next_clock_epoch(clock);
+        time_ref->window_ticks = clock->ticks;
+        time_ref->window_refs = 0;
     }
     else
-        *kernel_time = ktime_get();
+    {
+        clock->ticks += (u16)(ts16 - clock->ts16);
+        clock->ts16 = ts16;
+        if (with_host_time)
+            filter_time_reference(time_ref, host_time);
+    }
+    ++clock->tick_count;
+    *snapshot = *clock;
+
+    write_sequnlock(&time_ref->lock);
 }
 
 static int decode_timestamp_in_context(u8 is_first_packet, msg_context_t *ctx)
@@ -169,16 +458,25 @@ static int decode_timestamp_in_context(u8 is_first_packet, msg_context_t *ctx)
 static int decode_error(msg_context_t *ctx, u8 number, u8 status_len)
 {
     usb_forwarder_t *forwarder = (usb_forwarder_t *)netdev_priv(ctx->netdev);
+    pcan_chardev_t *chardev = &forwarder->char_dev;
+    bool chardev_opened = (atomic_read(&chardev->open_count) > 0);
     enum can_state new_state = forwarder->can.state;
+    struct can_frame chardev_frame;
     struct can_frame *frame = NULL;
     bool net_up = netif_running(ctx->netdev);
     struct sk_buff *skb = NULL;
+    pcan_timestamps_t timestamps;
 
-    if (!net_up) /* FIXME: Does chardev need error report? */
+    /* ignore this error until 1st ts received */
+    if (number == PCAN_USB_ERROR_QOVR && !ctx->clock.tick_count)
         return 0;
 
-    /* ignore this error until 1st ts received */
-    if (number == PCAN_USB_ERROR_QOVR && !forwarder->time_ref.tick_count)
+    /* Accounted whether netdev is up or not, since frames have been lost anyway. */
+    if (number & (PCAN_USB_ERROR_RXQOVR | PCAN_USB_ERROR_QOVR))
+        atomic64_inc(&chardev->rx_drops.dev_overruns);
+    WRITE_ONCE(chardev->dev_overrun, !!(number & (PCAN_USB_ERROR_RXQOVR | PCAN_USB_ERROR_QOVR)));
+
+    if (!net_up && !chardev_opened)
         return 0;
 
     switch (forwarder->can.state)
@@ -249,16 +547,25 @@ static int decode_error(msg_context_t *ctx, u8 number, u8 status_len)
     if (forwarder->can.state == new_state)
         return 0;
 
-    skb = net_up ? alloc_can_skb(ctx->netdev, &frame) : NULL;
+    skb = net_up ? alloc_can_err_skb(ctx->netdev, &frame) : NULL;
     if (net_up && !skb)
         return -ENOMEM;
 
+    if (!skb)
+    {
+        memset(&chardev_frame, 0, sizeof(chardev_frame));
+        chardev_frame.can_id = CAN_ERR_FLAG;
+        chardev_frame.can_dlc = CAN_ERR_DLC;
+        frame = &chardev_frame;
+    }
+
     switch (new_state)
     {
     case CAN_STATE_BUS_OFF:
         frame->can_id |= CAN_ERR_BUSOFF;
         ++forwarder->can.can_stats.bus_off;
-        can_bus_off(ctx->netdev);
+        if (net_up)
+            can_bus_off(ctx->netdev);
         break;
 
     case CAN_STATE_ERROR_PASSIVE:
@@ -285,73 +592,29 @@ static int decode_error(msg_context_t *ctx, u8 number, u8 status_len)
 
     forwarder->can.state = new_state;
 
-    /*if (net_up)
-    {*/
-        if (status_len & PCAN_USB_STATUSLEN_TIMESTAMP)
-        {
-            ktime_t hardware_timestamp;
-
-            compute_kernel_time(&(forwarder->time_ref), ctx->ts16, &hardware_timestamp);
-            skb_hwtstamps(skb)->hwtstamp = hardware_timestamp;
-        }
-
-        netif_rx(skb);
-
-        ++ctx->netdev->stats.rx_packets;
-        ctx->netdev->stats.rx_bytes += frame->can_dlc;
-    /*}*/
-
-    return 0;
-}
+    if (status_len & PCAN_USB_STATUSLEN_TIMESTAMP)
+        fill_timestamps(&ctx->clock, ctx->ts16, ctx->host_time, &timestamps);
+    else
+        fill_host_timestamps(&ctx->clock, ctx->ts16, ctx->host_time, &timestamps);
 
-static void update_time_reference(u32 ts_now, pcan_time_ref_t *time_ref)
-{
-    time_ref->ts_dev_2 = ts_now;
+    /* Dropped by chardev unless some opener allows PCANFD_ALLOWED_MSG_STATUS. */
+    if (chardev_opened)
+        pcan_chardev_push_status(chardev, frame, &timestamps);
 
-    /* should wait at least two passes before computing */
-    if (ktime_to_ns(time_ref->tv_host) > 0)
+    if (net_up)
     {
-        u32 delta_ts = time_ref->ts_dev_2 - time_ref->ts_dev_1;
-
-        if (time_ref->ts_dev_2 < time_ref->ts_dev_1)
-            delta_ts &= (1 << PCAN_USB_TS_USED_BITS) - 1;
-
-        time_ref->ts_total += delta_ts;
-    }
-}
+        u8 dlc = frame->can_dlc;
 
-static void set_time_reference(u32 ts_now, pcan_time_ref_t *time_ref)
-{
-    if (ktime_to_ns(time_ref->tv_host_0) == 0)
-    {
-        /* use monotonic clock to correctly compute further deltas */
-        time_ref->tv_host_0 = ktime_get();
-        time_ref->tv_host = ktime_set(0, 0);
-    }
-    else
-    {
-        /*
-         * delta_us should not be >= 2^32 => delta_s should be < 4294
-         * handle 32-bits wrapping here: if count of s. reaches 4200,
-         * reset counters and change time base
-         */
-        if (ktime_to_ns(time_ref->tv_host))
-        {
-            ktime_t delta = ktime_sub(time_ref->tv_host, time_ref->tv_host_0);
+        if (status_len & PCAN_USB_STATUSLEN_TIMESTAMP)
+            skb_hwtstamps(skb)->hwtstamp = cooked_timestamp(&timestamps);
 
-            if (ktime_to_ns(delta) > (4200ull * NSEC_PER_SEC))
-            {
-                time_ref->tv_host_0 = time_ref->tv_host;
-                time_ref->ts_total = 0;
-            }
+        queue_rx_skb(ctx, skb);
 
-            time_ref->tv_host = ktime_get();
-            ++time_ref->tick_count;
-        }
+        ++ctx->netdev->stats.rx_packets;
+        ctx->netdev->stats.rx_bytes += dlc;
     }
 
-    time_ref->ts_dev_1 = time_ref->ts_dev_2;
-    update_time_reference(ts_now, time_ref);
+    return 0;
 }
 
 static int update_timestamp_in_context(msg_context_t *ctx)
@@ -366,10 +629,8 @@ static int update_timestamp_in_context(msg_context_t *ctx)
 
     ctx->ts16 = le16_to_cpu(tmp16);
 
-    if (ctx->rec_idx > 0)
-        update_time_reference(ctx->ts16, &forwarder->time_ref);
-    else
-        set_time_reference(ctx->ts16, &forwarder->time_ref);
+    /* Only the first record is stamped close enough to the arrival of URB. */
+    update_time_reference(&forwarder->time_ref, ctx->ts16, 0 == ctx->rec_idx, ctx->host_time, &ctx->clock);
 
     return 0;
 }
@@ -434,36 +695,33 @@ static int decode_data(msg_context_t *ctx, u8 status_len)
 {
     usb_forwarder_t *forwarder = (usb_forwarder_t *)netdev_priv(ctx->netdev);
     pcan_chardev_t *chardev = &forwarder->char_dev;
-    int unread_count = (atomic_read(&chardev->open_count) < 1) ? -ESHUTDOWN : atomic_read(&chardev->rx_unread_cnt);
-    int rx_write_idx = atomic_read(&chardev->rx_write_idx);
-    pcan_chardev_msg_t *chardev_msg = (unread_count < 0 || unread_count >= PCAN_CHRDEV_MAX_RX_BUF_COUNT) ? NULL
-        : &chardev->rx_msgs[rx_write_idx];
-    ktime_t hardware_timestamp;
+    bool chardev_opened = (atomic_read(&chardev->open_count) > 0);
+    pcan_timestamps_t timestamps;
     u8 rec_len = status_len & PCAN_USB_STATUSLEN_DLC;
+    struct can_frame chardev_frame;
     struct can_frame *frame = NULL;
     bool net_up = netif_running(ctx->netdev);
     struct sk_buff *skb = net_up ? alloc_can_skb(ctx->netdev, &frame) : NULL;
+    bool skb_missing = (net_up && !skb);
 
-    if (net_up && !skb)
-        return -ENOMEM;
-
-    if (!frame)
+    if (skb_missing)
+    {
+        /* Decode it all the same, so that chardev still gets it and the rest records are not lost. */
+        atomic64_inc(&chardev->rx_drops.no_skb);
+        ++ctx->netdev->stats.rx_dropped;
+        net_up = false;
+        frame = &chardev_frame;
+    }
+    else if (!frame)
     {
-        if (unread_count < 0)
+        if (!chardev_opened)
         {
             dev_err_ratelimited_v(chardev->device, "Device not opened.\n");
 
-            return unread_count;
+            return -ESHUTDOWN;
         }
 
-        if (unread_count >= PCAN_CHRDEV_MAX_RX_BUF_COUNT)
-        {
-            /* dev_err_ratelimited_v(chardev->device, "Rx buffer full\n"); */
-
-            return -ENOBUFS;
-        }
-
-        frame = &chardev_msg->frame;
+        frame = &chardev_frame;
     }
 
     if (status_len & PCAN_USB_STATUSLEN_EXT_ID)
@@ -508,40 +766,43 @@ static int decode_data(msg_context_t *ctx, u8 status_len)
         ctx->ptr += rec_len;
     }
 
-    compute_kernel_time(&(forwarder->time_ref), ctx->ts16, &hardware_timestamp);
-
-    if (net_up)
+    if (unlikely(!usbdrv_acc_filter_pass(forwarder, frame->can_id)))
     {
-        skb_hwtstamps(skb)->hwtstamp = hardware_timestamp;
+        /* Let through by the hardware filter, which can not express the acceptance code and mask exactly. */
+        if (skb)
+            dev_kfree_skb(skb);
 
-        netif_rx(skb);
-
-        ++ctx->netdev->stats.rx_packets;
-        ctx->netdev->stats.rx_bytes += frame->can_dlc;
+        return 0;
     }
 
-    if (chardev_msg)
+    fill_timestamps(&ctx->clock, ctx->ts16, ctx->host_time, &timestamps);
+
+    /* NOTE: Push it to chardev before queuing the skb, which might be freed by NAPI then. */
+    if (chardev_opened)
     {
-        unsigned long lock_flags;
+        int err = pcan_chardev_push_rx_msg(chardev, frame, &timestamps);
 
-        chardev_msg->hwtstamp = hardware_timestamp;
-        if (frame != &chardev_msg->frame)
+        if (err && !net_up)
         {
-            memcpy(&chardev_msg->frame, frame, sizeof(*frame));
+            /* dev_err_ratelimited_v(chardev->device, "Rx buffer full\n"); */
+
+            return err;
         }
+    }
 
-        spin_lock_irqsave(&chardev->lock, lock_flags);
+    if (net_up)
+    {
+        u8 dlc = frame->can_dlc;
 
-        atomic_set(&chardev->rx_write_idx, (++rx_write_idx) % PCAN_CHRDEV_MAX_RX_BUF_COUNT);
-        atomic_inc(&chardev->rx_unread_cnt);
-        ++chardev->rx_packets;
+        skb_hwtstamps(skb)->hwtstamp = cooked_timestamp(&timestamps);
 
-        spin_unlock_irqrestore(&chardev->lock, lock_flags);
+        queue_rx_skb(ctx, skb);
 
-        wake_up_interruptible(&chardev->wait_queue_rd);
+        ++ctx->netdev->stats.rx_packets;
+        ctx->netdev->stats.rx_bytes += dlc;
     }
 
-    return 0;
+    return skb_missing ? -ENOBUFS : 0;
 
 decode_failed:
 
@@ -558,8 +819,17 @@ static int decode_incoming_buf(const u8 *ibuf, u32 size, struct net_device *dev)
         , .ptr = ibuf + PCAN_USB_MSG_HEADER_LEN
         , .end = ibuf + size
         , .netdev = dev
+        , .host_time = ktime_get()
     };
+    usb_forwarder_t *forwarder = (usb_forwarder_t *)netdev_priv(dev);
+    int nobufs_err = 0;
     int err = 0;
+#ifdef INNER_TEST
+    cycles_t cycles = get_cycles();
+#endif
+
+    __skb_queue_head_init(&ctx.rx_skbs);
+    pcan_time_ref_snapshot(&forwarder->time_ref, &ctx.clock);
 
     for (err = 0; ctx.rec_idx < ctx.rec_cnt && !err; ++ctx.rec_idx)
     {
@@ -572,20 +842,44 @@ static int decode_incoming_buf(const u8 *ibuf, u32 size, struct net_device *dev)
             err = decode_data(&ctx, status_len);
             ++ctx.rec_data_idx;
         }
+
+        /* The record has been consumed, so go on with the rest ones. */
+        if (-ENOBUFS == err)
+        {
+            nobufs_err = err;
+            err = 0;
+        }
     }
 
-    return err;
+    /* Even if decoding failed halfway, since those pushed are intact. */
+    pcan_chardev_publish_rx_msgs(&forwarder->char_dev);
+    if (!skb_queue_empty(&ctx.rx_skbs))
+        pcan_net_queue_rx_skbs(dev, &ctx.rx_skbs);
+
+#ifdef INNER_TEST
+    forwarder->decode_cycles += get_cycles() - cycles;
+    forwarder->decoded_frames += ctx.rec_data_idx;
+    if (forwarder->decoded_frames >= (1 << 16))
+    {
+        netdev_notice_v(dev, "decoding took %llu cycles per frame\n",
+            div64_u64(forwarder->decode_cycles, forwarder->decoded_frames));
+        forwarder->decode_cycles = 0;
+        forwarder->decoded_frames = 0;
+    }
+#endif
+
+    return err ? err : nobufs_err;
 }
 
-int pcan_decode_and_handle_urb(const struct urb *urb, struct net_device *dev)
+int pcan_decode_and_handle_rx_buf(const u8 *buf, u32 len, struct net_device *dev)
 {
-    if (urb->actual_length > PCAN_USB_MSG_HEADER_LEN)
-        return decode_incoming_buf(urb->transfer_buffer, urb->actual_length, dev);
-    else if (urb->actual_length == 0)
+    if (len > PCAN_USB_MSG_HEADER_LEN)
+        return decode_incoming_buf(buf, len, dev);
+    else if (len == 0)
         return 0;
     else
     {
-        netdev_err_v(dev, "usb message length error (%u)\n", urb->actual_length);
+        netdev_err_v(dev, "usb message length error (%u)\n", len);
         return -EINVAL;
     }
 }
@@ -613,5 +907,39 @@ int pcan_decode_and_handle_urb(const struct urb *urb, struct net_device *dev)
  * >>> 2023-12-12, Man Hung-Coeng <udc577@126.com>:
  *  01. Disable the Rx-buffer-full error report,
  *      update rx_packets and wake up wait_queue_rd in decode_data().
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Hand decoded frames over to pcan_chardev_push_rx_msg(),
+ *      and keep decoding the rest records of a URB when chardev Rx buffer is full.
+ *  02. Pass the raw device timestamp to chardev too.
+ *  03. Fix the out-of-bounds write of Tx counter byte in pcan_encode_frame_to_buf().
+ *  04. Split the encoder into pcan_encode_tx_{begin,end}() and pcan_encode_frame_to_buf(),
+ *      the last of which appends a record to the buffer, so that a Tx URB can carry several frames.
+ *  05. Count Rx frames dropped due to device queue overruns and skb allocation failures,
+ *      and keep decoding (and feeding chardev) instead of giving up the URB on the latter.
+ *  06. Drop frames rejected by the acceptance filter but let through by the adapter.
+ *  07. Hand error frames of bus state changes over to chardev too, which keeps them only for
+ *      openers allowing PCANFD_ALLOWED_MSG_STATUS, and set CAN_ERR_FLAG on them as it should be.
+ *  08. Put error frames into the chardev status queue instead of the Rx ring.
+ *  09. Publish frames pushed to chardev once per URB, and measure cycles per frame
+ *      of decoding (INNER_TEST only).
+ *  10. Hand skbs of a URB over to NAPI of netdev in one go, sorted by hardware timestamp,
+ *      instead of calling netif_rx() on each.
+ *  11. Replace pcan_decode_and_handle_urb() with pcan_decode_and_handle_rx_buf(),
+ *      since the Rx URB is resubmitted with a spare buffer before decoding.
+ *  12. Estimate clock drift of device against host, and hand timestamps of all
+ *      PCANFD_OPT_HWTIMESTAMP_* modes over to chardev.
+ *  13. Replace the time reference rebased every 4200 s with a clock model on 64-bit ticks,
+ *      whose slope is steered by the least-latency reference of each window,
+ *      and which is read through seqlock-protected snapshots. Stamp netdev skbs by it.
+ *  14. Add pcan_time_ref_dev_ns() for reading device time at any host time.
+ *  15. Leave timestamp conversions to consumers, which do them only for events they take,
+ *      and number each change of the clock model by an epoch.
+ *  16. Apply the calibration offset and settings of the alignment service to every conversion
+ *      of device time, and add pcan_time_ref_new_epoch() and pcan_time_ref_set_offset().
+ *  17. Start a new epoch only when the conversion jumps, and number slope changes of each window by a revision.
+ *  18. Start a new epoch on slope changes of each window again instead of a revision,
+ *      so that no record is converted by a slope which was not in effect when it was received.
+ *  19. Keep whether the latest error message of device tells an overrun, for PCANFD_CANSTATUS_OVERRUN.
  */
 
@@ -12,23 +12,113 @@
 
 #include <linux/types.h> /* For size_t, u8, etc. */
 #include <linux/ktime.h> /* For ktime_t. */
+#include <linux/seqlock.h> /* For seqlock_t. */
+#include <linux/list.h> /* For struct list_head. */
+#include <linux/can.h> /* For struct can_frame and CAN_*_FLAG. */
 
 struct net_device;
-struct can_frame;
 struct urb;
 
+/*
+ * Model of the device clock against host CLOCK_MONOTONIC, updated by decoder on each time reference:
+ * host time of tick t is anchor_host + (t - anchor_ticks) * ns_per_tick_q32 / 2^32, where the slope
+ * is the nominal tick length corrected by the estimated frequency error plus a temporary phase slew.
+ * Only the slope changes after the first reference (unless the model is found milliseconds away),
+ * so timestamps never jump.
+ */
+typedef struct pcan_clock
+{
+    u32 tick_count; /* count of time references received since bus on */
+    u32 epoch; /* changed whenever the conversion of ticks into host time changes, never 0 once referenced */
+    u16 ts16; /* device timestamp of the last reference */
+    u64 ticks; /* ts16 extended to 64 bits */
+    u64 ticks_0; /* ticks of the first reference */
+    ktime_t host_0; /* host time of the first reference */
+    u64 anchor_ticks;
+    ktime_t anchor_host;
+    u64 ns_per_tick_q32;
+    s64 slope_ppb; /* how much ns_per_tick_q32 is beyond the nominal tick length, in parts per billion */
+    s64 freq_ppb; /* estimated frequency error, positive if host clock runs faster than device clock */
+    s64 offset_ns; /* calibration added to host time of every conversion for alignment, see time_align.h */
+} pcan_clock_t;
+
 /* time reference */
 typedef struct pcan_time_ref
 {
-    ktime_t tv_host_0, tv_host;
-    u32 ts_dev_1, ts_dev_2;
-    u64 ts_total;
-    u32 tick_count;
+    seqlock_t lock; /* written by decoder and pcan_time_ref_reset(), read through pcan_time_ref_snapshot() */
+    pcan_clock_t clock;
+    u64 window_ticks; /* beginning of the current filter window */
+    s64 window_min_err; /* least (host time - model) of references in the window, in ns */
+    u32 window_refs; /* count of references in the window */
+    struct list_head align_node; /* in the list of adapters affected by module parameter ts_align */
 } pcan_time_ref_t;
 
-int pcan_encode_frame_to_buf(const struct net_device *dev, const struct can_frame *frame, u8 *obuf, size_t *size);
+/*
+ * Timestamps of an Rx event in raw form, which are converted into those of PCANFD_OPT_HWTIMESTAMP_* modes
+ * only by the consumers needing them.
+ */
+typedef struct pcan_timestamps
+{
+    ktime_t host; /* host time when the URB carrying the event was decoded */
+    u64 ticks; /* device time, i.e., raw extended to 64 bits, or that of the last reference if none */
+    const pcan_clock_t *clock; /* clock model to convert ticks with, NULL if the event has no device time */
+    u32 raw; /* device timestamp as it was, in ticks */
+} pcan_timestamps_t;
+
+struct pcan_rx_ts_epoch;
+
+void pcan_time_ref_init(pcan_time_ref_t *time_ref);
+
+/* Forgets everything learned about the device clock, whose counter restarts on bus on. */
+void pcan_time_ref_reset(pcan_time_ref_t *time_ref);
+
+/* Copies a consistent clock model, can be called anywhere. */
+void pcan_time_ref_snapshot(pcan_time_ref_t *time_ref, pcan_clock_t *clock);
+
+/*
+ * Starts a new epoch, so that events from now on are converted according to the current value
+ * of module parameter ts_align, while those stamped before are left as they were.
+ */
+void pcan_time_ref_new_epoch(pcan_time_ref_t *time_ref);
+
+/* Sets the calibration offset of an adapter, which is kept across bus off and on. */
+void pcan_time_ref_set_offset(pcan_time_ref_t *time_ref, s64 offset_ns);
 
-int pcan_decode_and_handle_urb(const struct urb *urb, struct net_device *dev);
+/* Converts device ticks into microseconds, by nominal tick length. */
+u64 pcan_clock_ticks_to_us(u64 ticks);
+
+/* Host time of ticks on the line passing (base_ticks, base_host) with a slope of ns_per_tick_q32 / 2^32. */
+ktime_t pcan_ticks_to_host_time(ktime_t base_host, u64 base_ticks, u64 ns_per_tick_q32, u64 ticks);
+
+/* Fills the conversion parameters of a clock model (all but the epoch field) for chardev readers. */
+void pcan_clock_to_ts_epoch(const pcan_clock_t *clock, struct pcan_rx_ts_epoch *params);
+
+/*
+ * Device time in nanoseconds (by nominal tick length) at host_time of CLOCK_MONOTONIC, according to the clock model.
+ * Returns -ENODATA if no time reference has been received since bus on.
+ */
+int pcan_time_ref_dev_ns(pcan_time_ref_t *time_ref, ktime_t host_time, u64 *dev_ns);
+
+/* Length of the record of a frame in a Tx buffer. */
+static inline size_t pcan_encoded_frame_len(const struct can_frame *frame)
+{
+    return 1 /* status/len */ + ((frame->can_id & CAN_EFF_FLAG) ? 4 : 2) + ((frame->can_id & CAN_RTR_FLAG) ? 0 : frame->can_dlc);
+}
+
+/*
+ * Encodes frames into a Tx buffer of PCAN_USB_TX_BUFFER_SIZE bytes:
+ *  1. pcan_encode_tx_begin() writes the header, and sets *len to the count of bytes used;
+ *  2. each pcan_encode_frame_to_buf() appends a frame, or returns -ENOSPC if it doesn't fit;
+ *  3. pcan_encode_tx_end() writes the trailing counter byte.
+ */
+void pcan_encode_tx_begin(u8 *obuf, size_t *len);
+
+int pcan_encode_frame_to_buf(const struct can_frame *frame, u8 *obuf, size_t *len);
+
+void pcan_encode_tx_end(const struct net_device *dev, u8 *obuf);
+
+/* Decodes a buffer received by an Rx URB, which might have been resubmitted with another buffer already. */
+int pcan_decode_and_handle_rx_buf(const u8 *buf, u32 len, struct net_device *dev);
 
 #endif /* #ifndef __PACKET_CODEC_H__ */
 
@@ -42,5 +132,22 @@ int pcan_decode_and_handle_urb(const struct urb *urb, struct net_device *dev);
  *
  * >>> 2023-10-05, Man Hung-Coeng <udc577@126.com>:
  *  01. Change license to GPL-2.0.
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Encode several frames into one Tx buffer
+ *      with pcan_encode_tx_{begin,end}() and pcan_encode_frame_to_buf().
+ *  02. Replace pcan_decode_and_handle_urb() with pcan_decode_and_handle_rx_buf().
+ *  03. Add clock drift and device time base to struct pcan_time_ref,
+ *      struct pcan_timestamps and pcan_time_ref_dev_us().
+ *  04. Replace the time reference with a drift-tracking clock model on 64-bit ticks,
+ *      protected by a seqlock, and add pcan_time_ref_{init,reset,snapshot}()
+ *      and pcan_clock_ticks_to_us() in place of pcan_time_ref_dev_us().
+ *  05. Add pcan_time_ref_dev_ns().
+ *  06. Keep timestamps of struct pcan_timestamps in raw form, add an epoch to struct pcan_clock,
+ *      and add pcan_ticks_to_host_time() and pcan_clock_to_ts_epoch() for converting them later.
+ *  07. Add a calibration offset to struct pcan_clock, an alignment list node to struct pcan_time_ref,
+ *      and pcan_time_ref_new_epoch() and pcan_time_ref_set_offset().
+ *  08. Start a new epoch on every change of the conversion again, so that records keep theirs.
+ *  09. Describe the alignment list and epochs by module parameter ts_align instead of a service.
  */
 
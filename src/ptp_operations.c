@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * Implementation of PTP hardware clock of PCAN-USB.
+ *
+ * Copyright (c) 2026 Man Hung-Coeng <udc577@126.com>
+ * All rights reserved.
+*/
+
+#include "ptp_operations.h"
+
+#include <linux/version.h>
+
+#include "common.h"
+#include "klogging.h"
+#include "packet_codec.h"
+#include "usb_driver.h"
+
+#if IS_REACHABLE(CONFIG_PTP_1588_CLOCK)
+
+/*
+ * Device time as it is, i.e., the time base of PCANFD_OPT_HWTIMESTAMP_RAW timestamps,
+ * which reads 0 until the first time reference after bus on, the same as the timestamps.
+ */
+static u64 read_dev_ns(pcan_ptp_t *ptp)
+{
+    usb_forwarder_t *forwarder = container_of(ptp, usb_forwarder_t, ptp);
+    u64 dev_ns;
+
+    return (pcan_time_ref_dev_ns(&forwarder->time_ref, ktime_get(), &dev_ns) < 0) ? 0 : dev_ns;
+}
+
+/* The adapter clock can't be set or steered, and a software one would lose its tie to Rx timestamps. */
+static int ptp_adjfine(struct ptp_clock_info *info, long scaled_ppm)
+{
+    return -EOPNOTSUPP;
+}
+
+static int ptp_adjtime(struct ptp_clock_info *info, s64 delta)
+{
+    return -EOPNOTSUPP;
+}
+
+static int ptp_settime64(struct ptp_clock_info *info, const struct timespec64 *ts)
+{
+    return -EOPNOTSUPP;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 0, 0)
+static int ptp_gettimex64(struct ptp_clock_info *info, struct timespec64 *ts, struct ptp_system_timestamp *sts)
+{
+    pcan_ptp_t *ptp = container_of(info, pcan_ptp_t, info);
+    u64 ns;
+
+    ptp_read_system_prets(sts);
+    ns = read_dev_ns(ptp); /* Device time is computed from host time read right here. */
+    ptp_read_system_postts(sts);
+
+    *ts = ns_to_timespec64(ns);
+
+    return 0;
+}
+#else
+static int ptp_gettime64(struct ptp_clock_info *info, struct timespec64 *ts)
+{
+    *ts = ns_to_timespec64(read_dev_ns(container_of(info, pcan_ptp_t, info)));
+
+    return 0;
+}
+#endif
+
+static int ptp_enable(struct ptp_clock_info *info, struct ptp_clock_request *request, int on)
+{
+    return -EOPNOTSUPP; /* No alarm, external timestamp or periodic output at all. */
+}
+
+void pcan_ptp_register(usb_forwarder_t *forwarder, struct device *parent)
+{
+    static const struct ptp_clock_info S_PTP_INFO = {
+        .owner = THIS_MODULE
+        , .name = "pcan_usb"
+        , .max_adj = 0
+        , .adjfine = ptp_adjfine
+        , .adjtime = ptp_adjtime
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 0, 0)
+        , .gettimex64 = ptp_gettimex64
+#else
+        , .gettime64 = ptp_gettime64
+#endif
+        , .settime64 = ptp_settime64
+        , .enable = ptp_enable
+    };
+    pcan_ptp_t *ptp = &forwarder->ptp;
+
+    ptp->info = S_PTP_INFO;
+    ptp->clock = ptp_clock_register(&ptp->info, parent);
+    if (IS_ERR_OR_NULL(ptp->clock))
+    {
+        dev_warn_v(parent, "PTP clock not registered: %ld\n", PTR_ERR(ptp->clock));
+        ptp->clock = NULL;
+
+        return;
+    }
+
+    dev_notice_v(parent, "PTP clock registered as ptp%d\n", ptp_clock_index(ptp->clock));
+}
+
+void pcan_ptp_unregister(usb_forwarder_t *forwarder)
+{
+    if (forwarder->ptp.clock)
+    {
+        ptp_clock_unregister(forwarder->ptp.clock);
+        forwarder->ptp.clock = NULL;
+    }
+}
+
+int pcan_ptp_index(const usb_forwarder_t *forwarder)
+{
+    return forwarder->ptp.clock ? ptp_clock_index(forwarder->ptp.clock) : -1;
+}
+
+#else /* IS_REACHABLE(CONFIG_PTP_1588_CLOCK) */
+
+void pcan_ptp_register(usb_forwarder_t *forwarder, struct device *parent)
+{
+    forwarder->ptp.clock = NULL;
+}
+
+void pcan_ptp_unregister(usb_forwarder_t *forwarder)
+{
+}
+
+int pcan_ptp_index(const usb_forwarder_t *forwarder)
+{
+    return -1;
+}
+
+#endif /* IS_REACHABLE(CONFIG_PTP_1588_CLOCK) */
+
+/*
+ * ================
+ *   CHANGE LOG
+ * ================
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Create.
+ *  02. Make the PHC read-only device time, so that it keeps the time base of RAW timestamps.
+ */
+
@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/*
+ * PTP hardware clock of PCAN-USB.
+ *
+ * Copyright (c) 2026 Man Hung-Coeng <udc577@126.com>
+ * All rights reserved.
+*/
+
+#ifndef __PTP_OPERATIONS_H__
+#define __PTP_OPERATIONS_H__
+
+#include <linux/ptp_clock_kernel.h> /* For struct ptp_clock_info. */
+
+struct usb_forwarder;
+
+/*
+ * The adapter clock as a read-only PHC (/dev/ptpN), which reads device time of the clock model of decoder,
+ * i.e., the time base of PCANFD_OPT_HWTIMESTAMP_RAW timestamps, so that user space can relate them
+ * to host time (by phc2sys -O, ts2phc, etc.). It can't be set or adjusted (-EOPNOTSUPP),
+ * since the adapter counter can't, and it restarts from 0 on bus on, just as RAW timestamps do.
+ */
+typedef struct pcan_ptp
+{
+    struct ptp_clock_info info;
+    struct ptp_clock *clock; /* NULL if not registered */
+} pcan_ptp_t;
+
+/*
+ * Registers the PHC of an adapter, failures of which are only logged,
+ * since the PHC is optional (and unavailable if CONFIG_PTP_1588_CLOCK is off).
+ */
+void pcan_ptp_register(struct usb_forwarder *forwarder, struct device *parent);
+
+void pcan_ptp_unregister(struct usb_forwarder *forwarder);
+
+/* Index of the PHC (i.e., N of /dev/ptpN), or -1 if not registered. */
+int pcan_ptp_index(const struct usb_forwarder *forwarder);
+
+#endif /* #ifndef __PTP_OPERATIONS_H__ */
+
+/*
+ * ================
+ *   CHANGE LOG
+ * ================
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Create.
+ *  02. Make the PHC read-only device time, and remove the timecounter.
+ */
+
@@ -7,20 +7,27 @@
  * All rights reserved.
 */
 
+#define _GNU_SOURCE /* For splice(). */
+
 #include <signal.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
 
 #include "versions.h"
 #include "common.h"
 #include "signal_handling.h"
 #include "chardev_operations.h"
+#include "chardev_ioctl.h"
 
 #define TO_STR(x)                                   #x
 
@@ -33,6 +40,7 @@ typedef enum option_type
     OPT_TYPE_SEND_INTERVAL = 4,
     OPT_TYPE_DATA_FILE = 5,
     OPT_TYPE_POLL_TIMEOUT = 6,
+    OPT_TYPE_COMPACT_MODE = 7,
 
     OPT_TYPE_MAX
 } option_type_t;
@@ -46,7 +54,8 @@ typedef struct cmdline_params
     uint32_t bit_rate;
     int32_t cycle_count;
     uint32_t is_blocking:1;
-    uint32_t send_interval_usecs:31;
+    uint32_t is_compact:1;
+    uint32_t send_interval_usecs:30;
     int32_t poll_timeout_msecs;
     char data_file[256];
     char cmd[8];
@@ -65,13 +74,15 @@ static void show_help(const char *program, FILE *where)
     fprintf(where, "Supported commands:\n");
     fprintf(where, "    nop: No OPerations (for inner test only).\n");
     fprintf(where, "    read: Read and print data from device.\n");
-    fprintf(where, "    write: Write data to device.\n");
+    fprintf(where, "    mmap: Print data from Rx ring of device mapped into memory.\n");
+    fprintf(where, "    write: Write a counter as data to device periodically.\n");
+    fprintf(where, "    log: Splice compact binary messages from device into the file specified by -f option (stdout if unspecified).\n");
     fprintf(where, "    get: Get value of the parameter specified -g option.\n");
     fprintf(where, "    set: Set the parameter to a value, both of which are specified by -s option.\n");
     fprintf(where, "Supported options:\n");
     fprintf(where, "    -b: Run in blocking mode.\n");
     fprintf(where, "    -c <cycle count>: Specify cycle count for test (%d if unspecified).\n", DEFAULT_CYCLE_COUNT);
-    fprintf(where, "    -f <data file>: Specify data file (%s if unspecified).\n", DEFAULT_DATA_FILE);
+    fprintf(where, "    -f <data file>: Specify data file (%s if unspecified, except for log command).\n", DEFAULT_DATA_FILE);
     fprintf(where, "    -g <param_name>: Specify the parameter to get.\n");
     fprintf(where, "    -h: Show this help info.\n");
     fprintf(where, "    -i <send interval>: Specify send interval in microseconds (%d if unspecified).\n", DEFAULT_SEND_INTERVAL);
@@ -80,6 +91,7 @@ static void show_help(const char *program, FILE *where)
     fprintf(where, "    -s <pname>=<pvalue>: Specify the parameter and its value to set.\n");
     fprintf(where, "    -t <poll timeout>: Specify poll timeout in milliseconds (%d if unspecified).\n", DEFAULT_POLL_TIMEOUT);
     fprintf(where, "    -v: Show version.\n");
+    fprintf(where, "    -x: Read messages in compact binary format instead of text.\n");
 }
 
 static void parse_command_line(int argc, char **argv, cmdline_params_t *cmdl_params)
@@ -98,7 +110,7 @@ static void parse_command_line(int argc, char **argv, cmdline_params_t *cmdl_par
     cmd[sizeof(cmdl_params->cmd) - 1] = '\0';
 
     if (0 != strcmp("nop", cmd) &&
-        0 != strcmp("read", cmd) && 0 != strcmp("write", cmd) &&
+        0 != strcmp("read", cmd) && 0 != strcmp("mmap", cmd) && 0 != strcmp("write", cmd) && 0 != strcmp("log", cmd) &&
         0 != strcmp("get", cmd) && 0 != strcmp("set", cmd) &&
         0 != strcmp("-h", cmd) && 0 != strcmp("-v", cmd))
     {
@@ -122,7 +134,7 @@ static void parse_command_line(int argc, char **argv, cmdline_params_t *cmdl_par
     cmdl_params->poll_timeout_msecs = DEFAULT_POLL_TIMEOUT;
     strcpy(cmdl_params->data_file, DEFAULT_DATA_FILE);
 
-    while (-1 != (opt = getopt(argc, argv, "-bc:f:g:hi:n:r:s:t:v")))
+    while (-1 != (opt = getopt(argc, argv, "-bc:f:g:hi:n:r:s:t:vx")))
     {
         switch (opt)
         {
@@ -135,6 +147,7 @@ static void parse_command_line(int argc, char **argv, cmdline_params_t *cmdl_par
             break;
 
         case 'f':
+            SPECIFY_OPTION(cmdl_params->option_bits, OPT_TYPE_DATA_FILE);
             memset(cmdl_params->data_file, 0, sizeof(cmdl_params->data_file));
             if (optarg)
                 strncpy(cmdl_params->data_file, optarg, sizeof(cmdl_params->data_file) - 1);
@@ -174,6 +187,11 @@ static void parse_command_line(int argc, char **argv, cmdline_params_t *cmdl_par
             fprintf(stdout, APP_VERSION "-" __VER__ "\n");
             exit(EXIT_SUCCESS);
 
+        case 'x':
+            SPECIFY_OPTION(cmdl_params->option_bits, OPT_TYPE_COMPACT_MODE);
+            cmdl_params->is_compact = true;
+            break;
+
         case '?':
             fprintf(stderr, "Unknown option -%c\n", opt);
             exit(EXIT_FAILURE);
@@ -199,14 +217,42 @@ static int do_nop(int fd, const cmdline_params_t *cmdl_params)
     return EXIT_SUCCESS;
 }
 
+static void print_compact_msgs(const pcanfd_compact_msg_t *msgs, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const pcanfd_compact_msg_t *m = &msgs[i];
+
+        printf("(%llu.%06llu)  %08X  [%u] ", (unsigned long long)(m->ts_ns / 1000000000),
+            (unsigned long long)(m->ts_ns % 1000000000 / 1000), m->id, m->dlc);
+        for (uint8_t j = 0; j < m->dlc && j < sizeof(m->data); ++j)
+        {
+            printf(" %02X", m->data[j]);
+        }
+        printf("%s\n", (m->flags & PCANFD_MSG_RTR) ? "  RTR" : "");
+    }
+}
+
 //#define DYNAMIC_READ_BUFFER
 
 static int do_read(int fd, const cmdline_params_t *cmdl_params)
 {
+    if (cmdl_params->is_compact)
+    {
+        uint32_t mode = PCANFD_READ_MODE_COMPACT;
+        pcanfd_ioctl_option_t opt = { .size = sizeof(mode), .name = PCANFD_OPT_READ_MODE, .value = &mode };
+
+        if (ioctl(fd, PCANFD_IOCTL_SET_OPTION, &opt) < 0)
+        {
+            perror("ioctl(PCANFD_OPT_READ_MODE)");
+            return EXIT_FAILURE;
+        }
+    }
+
 #ifdef DYNAMIC_READ_BUFFER
-    char *buf = (char *)calloc(PCAN_CHRDEV_MAX_BYTES_PER_READ * PCAN_CHRDEV_MAX_RX_BUF_COUNT + 1, sizeof(char));
+    char *buf = (char *)calloc(PCAN_CHRDEV_MAX_BYTES_PER_READ * PCAN_CHRDEV_MAX_MSGS_PER_READ + 1, sizeof(char));
 #else
-    char buf[PCAN_CHRDEV_MAX_BYTES_PER_READ * PCAN_CHRDEV_MAX_RX_BUF_COUNT + 1] = { 0 };
+    char buf[PCAN_CHRDEV_MAX_BYTES_PER_READ * PCAN_CHRDEV_MAX_MSGS_PER_READ + 1] __attribute__((aligned(8))) = { 0 };
 #endif
     ssize_t bytes;
 
@@ -258,11 +304,14 @@ static int do_read(int fd, const cmdline_params_t *cmdl_params)
             }
         }
 
-        bytes = read(fd, buf, PCAN_CHRDEV_MAX_BYTES_PER_READ * PCAN_CHRDEV_MAX_RX_BUF_COUNT + 1);
+        bytes = read(fd, buf, PCAN_CHRDEV_MAX_BYTES_PER_READ * PCAN_CHRDEV_MAX_MSGS_PER_READ + 1);
 
         if (bytes > 0)
         {
-            printf("%s", buf);
+            if (cmdl_params->is_compact)
+                print_compact_msgs((const pcanfd_compact_msg_t *)buf, bytes / sizeof(pcanfd_compact_msg_t));
+            else
+                printf("%s", buf);
             continue;
         }
 
@@ -279,13 +328,302 @@ static int do_read(int fd, const cmdline_params_t *cmdl_params)
     return EXIT_SUCCESS;
 }
 
+static bool wait_for_readable(int fd, const cmdline_params_t *cmdl_params)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    int ret = poll(&pfd, 1, cmdl_params->is_blocking ? -1 : cmdl_params->poll_timeout_msecs);
+
+    if (ret < 0)
+    {
+        perror("poll failure");
+        return false;
+    }
+
+    if (0 != (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+    {
+        fprintf(stderr, "Polling error: revents = 0x%x\n", pfd.revents);
+        return false;
+    }
+
+    return true;
+}
+
+/* (ticks - base_ticks) * ns_per_tick_q32 / 2^32 without overflow, where the delta of ticks is signed. */
+static int64_t ticks_delta_to_ns(uint64_t ticks, uint64_t base_ticks, uint64_t ns_per_tick_q32)
+{
+    uint64_t delta = (ticks >= base_ticks) ? ticks - base_ticks : base_ticks - ticks;
+    uint64_t ns = (delta >> 32) * ns_per_tick_q32 + (((delta & 0xffffffff) * ns_per_tick_q32) >> 32);
+
+    return (ticks >= base_ticks) ? (int64_t)ns : -(int64_t)ns;
+}
+
+/* Copies a consistent entry of conversion parameters, which the driver may be reusing for a newer epoch. */
+static void read_ts_epoch(const pcan_rx_ts_epoch_t *entry, pcan_rx_ts_epoch_t *params)
+{
+    uint32_t seq;
+
+    do
+    {
+        seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+        memcpy(params, entry, sizeof(*params));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || __atomic_load_n(&entry->seq, __ATOMIC_RELAXED) != seq);
+}
+
+/*
+ * Timestamp of a record in the way of PCANFD_OPT_HWTIMESTAMP_COOKED (the default of read() and ioctl()),
+ * of CLOCK_MONOTONIC, in nanoseconds,
+ * or host time if the record has no device time or is too old to be converted, which *from_device tells.
+ */
+static uint64_t record_mono_ns(const pcan_rx_ring_ctrl_t *ctrl, const pcan_rx_record_t *rec, bool *from_device)
+{
+    pcan_rx_ts_epoch_t params;
+
+    *from_device = false;
+    if (0 == rec->ts_epoch) /* No device time at all. */
+        return rec->ts_host_ns;
+
+    read_ts_epoch(&ctrl->ts_epochs[rec->ts_epoch & (PCAN_RX_TS_EPOCHS - 1)], &params);
+    if (params.epoch != rec->ts_epoch) /* Reused by a newer epoch, whose parameters don't apply. */
+        return rec->ts_host_ns;
+
+    *from_device = true;
+
+    return params.cooked_host_ns + ticks_delta_to_ns(rec->ts_ticks, params.cooked_ticks, params.cooked_ns_per_tick_q32);
+}
+
+/* CLOCK_REALTIME - CLOCK_MONOTONIC, in nanoseconds. */
+static int64_t realtime_offset_ns(void)
+{
+    struct timespec mono, real;
+
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &real);
+
+    return (int64_t)(real.tv_sec - mono.tv_sec) * 1000000000 + (real.tv_nsec - mono.tv_nsec);
+}
+
+static int do_mmap(int fd, const cmdline_params_t *cmdl_params)
+{
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    pcan_rx_ring_ctrl_t *ctrl = (pcan_rx_ring_ctrl_t *)mmap(NULL, page_size, PROT_READ, MAP_SHARED, fd, 0);
+    size_t map_size;
+
+    if (MAP_FAILED == ctrl)
+    {
+        perror("mmap() for control page");
+        return EXIT_FAILURE;
+    }
+
+    if (PCAN_RX_RING_VERSION != ctrl->version || sizeof(pcan_rx_record_t) != ctrl->record_size)
+    {
+        fprintf(stderr, "Unsupported Rx ring: version = %u, record size = %u\n", ctrl->version, ctrl->record_size);
+        munmap(ctrl, page_size);
+        return EXIT_FAILURE;
+    }
+
+    map_size = ctrl->records_offset + (size_t)ctrl->capacity * ctrl->record_size;
+    map_size = (map_size + page_size - 1) / page_size * page_size;
+    munmap(ctrl, page_size);
+
+    if (MAP_FAILED == (ctrl = (pcan_rx_ring_ctrl_t *)mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0)))
+    {
+        perror("mmap() for whole ring");
+        return EXIT_FAILURE;
+    }
+
+    const pcan_rx_record_t *records = (const pcan_rx_record_t *)((char *)ctrl + ctrl->records_offset);
+    uint32_t capacity = ctrl->capacity;
+    uint32_t cursor = __atomic_load_n(&ctrl->head, __ATOMIC_ACQUIRE); /* Only messages from now on. */
+    uint64_t lost = 0;
+
+    for (int32_t i = 0; ((cmdl_params->cycle_count < 0) ? true : (i < cmdl_params->cycle_count)); ++i)
+    {
+        uint32_t head = __atomic_load_n(&ctrl->head, __ATOMIC_ACQUIRE);
+
+        if (sig_check_critical_flag())
+        {
+            fprintf(stderr, "Interrupted by signal.\n");
+            break;
+        }
+
+        if (head == cursor)
+        {
+            if (!wait_for_readable(fd, cmdl_params))
+                break;
+
+            continue;
+        }
+
+        if (head - cursor > capacity)
+        {
+            lost += head - cursor - capacity;
+            cursor = head - capacity;
+        }
+
+        int64_t real_offset_ns = realtime_offset_ns();
+
+        for (; cursor != head; ++cursor)
+        {
+            const pcan_rx_record_t *slot = &records[cursor & (capacity - 1)];
+            pcan_rx_record_t rec;
+
+            if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != cursor)
+                break;
+
+            memcpy(&rec, slot, sizeof(rec));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+            if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != cursor) /* Overwritten while being copied. */
+                break;
+
+            bool from_device;
+            uint64_t ts_real_ns = record_mono_ns(ctrl, &rec, &from_device) + real_offset_ns;
+
+            /* A trailing '*' marks host time. */
+            printf("(%llu.%06llu)%c %08X  [%u] ", (unsigned long long)(ts_real_ns / 1000000000),
+                (unsigned long long)(ts_real_ns % 1000000000 / 1000), from_device ? ' ' : '*',
+                rec.can_id & 0x1fffffff, rec.can_dlc);
+            for (uint8_t j = 0; j < rec.can_dlc && j < sizeof(rec.data); ++j)
+            {
+                printf(" %02X", rec.data[j]);
+            }
+            printf("\n");
+        }
+    }
+
+    if (lost)
+        fprintf(stderr, "%llu messages lost due to overrun.\n", (unsigned long long)lost);
+
+    munmap(ctrl, map_size);
+
+    return EXIT_SUCCESS;
+}
+
+/* Counter generator: sends message 0x123 carrying the cycle index as data, in compact binary format. */
 static int do_write(int fd, const cmdline_params_t *cmdl_params)
 {
-    printf("%s: TODO ...\n", cmdl_params->cmd);
+    pcanfd_compact_msg_t msg = { .id = 0x123, .type = PCANFD_TYPE_CAN20_MSG, .dlc = 8 };
+
+    for (int32_t i = 0; ((cmdl_params->cycle_count < 0) ? true : (i < cmdl_params->cycle_count)); ++i)
+    {
+        if (sig_check_critical_flag())
+        {
+            fprintf(stderr, "Interrupted by signal.\n");
+            break;
+        }
+
+        memcpy(msg.data, &i, sizeof(i));
+
+        if (write(fd, &msg, sizeof(msg)) < 0)
+        {
+            if (!cmdl_params->is_blocking && EAGAIN == errno)
+            {
+                struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+
+                --i;
+                poll(&pfd, 1, cmdl_params->poll_timeout_msecs);
+                continue;
+            }
+
+            perror("write()");
+            return EXIT_FAILURE;
+        }
+
+        if (cmdl_params->send_interval_usecs)
+            usleep(cmdl_params->send_interval_usecs);
+    }
 
     return EXIT_SUCCESS;
 }
 
+/* Moves messages from device to file through a pipe by splice(), without copying them into user space. */
+static int do_log(int fd, const cmdline_params_t *cmdl_params)
+{
+    uint32_t mode = PCANFD_READ_MODE_COMPACT;
+    pcanfd_ioctl_option_t opt = { .size = sizeof(mode), .name = PCANFD_OPT_READ_MODE, .value = &mode };
+    bool to_file = OPTION_IS_SPECIFIED(cmdl_params->option_bits, OPT_TYPE_DATA_FILE);
+    size_t chunk = sizeof(pcanfd_compact_msg_t) * PCAN_CHRDEV_MAX_MSGS_PER_READ;
+    unsigned long long total = 0;
+    int pipe_fds[2] = { -1, -1 };
+    int out_fd;
+    int ret = EXIT_SUCCESS;
+
+    if (ioctl(fd, PCANFD_IOCTL_SET_OPTION, &opt) < 0)
+    {
+        perror("ioctl(PCANFD_OPT_READ_MODE)");
+        return EXIT_FAILURE;
+    }
+
+    if ((out_fd = to_file ? open(cmdl_params->data_file, O_WRONLY | O_CREAT | O_TRUNC, 0644) : STDOUT_FILENO) < 0)
+    {
+        perror(cmdl_params->data_file);
+        return EXIT_FAILURE;
+    }
+
+    if (pipe(pipe_fds) < 0)
+    {
+        perror("pipe()");
+        ret = EXIT_FAILURE;
+        goto lbl_log_end;
+    }
+
+    for (int32_t i = 0; ((cmdl_params->cycle_count < 0) ? true : (i < cmdl_params->cycle_count)); ++i)
+    {
+        ssize_t bytes;
+
+        if (sig_check_critical_flag())
+        {
+            fprintf(stderr, "Interrupted by signal.\n");
+            break;
+        }
+
+        if (!cmdl_params->is_blocking && !wait_for_readable(fd, cmdl_params))
+            break;
+
+        bytes = splice(fd, NULL, pipe_fds[1], NULL, chunk, SPLICE_F_MOVE);
+        if (bytes < 0)
+        {
+            if (EAGAIN == errno || EINTR == errno)
+                continue;
+
+            perror("splice() from device");
+            ret = EXIT_FAILURE;
+            break;
+        }
+
+        while (bytes > 0)
+        {
+            ssize_t written = splice(pipe_fds[0], NULL, out_fd, NULL, bytes, SPLICE_F_MOVE);
+
+            if (written <= 0)
+            {
+                perror("splice() to file");
+                ret = EXIT_FAILURE;
+                goto lbl_log_end;
+            }
+
+            bytes -= written;
+            total += written;
+        }
+    }
+
+lbl_log_end:
+
+    fprintf(stderr, "%llu messages logged.\n", total / sizeof(pcanfd_compact_msg_t));
+
+    if (pipe_fds[0] >= 0)
+    {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    }
+
+    if (to_file)
+        close(out_fd);
+
+    return ret;
+}
+
 static int do_get(int fd, const cmdline_params_t *cmdl_params)
 {
     printf("%s: TODO ...\n", cmdl_params->cmd);
@@ -322,8 +660,12 @@ static int handle_command(const cmdline_params_t *cmdl_params)
         ret = do_nop(fd, cmdl_params);
     else if (0 == strcmp("read", cmd))
         ret = do_read(fd, cmdl_params);
+    else if (0 == strcmp("mmap", cmd))
+        ret = do_mmap(fd, cmdl_params);
     else if (0 == strcmp("write", cmd))
         ret = do_write(fd, cmdl_params);
+    else if (0 == strcmp("log", cmd))
+        ret = do_log(fd, cmdl_params);
     else if (0 == strcmp("get", cmd))
         ret = do_get(fd, cmdl_params);
     else
@@ -364,5 +706,18 @@ int main(int argc, char **argv)
  * >>> 2023-12-28, Man Hung-Coeng <udc577@126.com>:
  *  01. Remove recv and send commands,
  *      and add nop, read (implemented) and write commands.
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Size the read buffer by PCAN_CHRDEV_MAX_MSGS_PER_READ.
+ *  02. Add mmap command.
+ *  03. Keep a private cursor in mmap command, as the Rx ring is shared by all openers.
+ *  04. Add -x option to read messages in compact binary format.
+ *  05. Implement write command with compact messages.
+ *  06. Add log command moving messages into a file by splice().
+ *  07. Convert raw timestamps of records in mmap command by parameters of their epochs.
+ *  08. Read entries of conversion parameters as sequence locks, and convert a record whose epoch
+ *      has been reused by the latest epoch instead of by host time.
+ *  09. Show records of reused epochs by host time with a mark instead of converting them by another epoch.
+ *  10. Convert timestamps of mmap command in the way of PCANFD_OPT_HWTIMESTAMP_COOKED, the default of driver.
  */
 
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * Implementation of driver-wide alignment of timestamps of PCAN-USB adapters.
+ *
+ * Copyright (c) 2026 Man Hung-Coeng <udc577@126.com>
+ * All rights reserved.
+*/
+
+#include "time_align.h"
+
+#include <linux/module.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/math64.h> /* For mul_u64_u64_shr(). */
+
+#include "common.h"
+#include "klogging.h"
+#include "packet_codec.h"
+
+#define DEFAULT_TS_ALIGN_FLAG           0
+
+static LIST_HEAD(s_time_refs);
+static DEFINE_MUTEX(s_time_refs_lock); /* protects s_time_refs */
+
+static bool ts_align = DEFAULT_TS_ALIGN_FLAG;
+
+static int set_ts_align(const char *val, const struct kernel_param *kp)
+{
+    pcan_time_ref_t *time_ref;
+    int err = param_set_bool(val, kp);
+
+    if (err)
+        return err;
+
+    mutex_lock(&s_time_refs_lock);
+    list_for_each_entry(time_ref, &s_time_refs, align_node)
+    {
+        pcan_time_ref_new_epoch(time_ref);
+    }
+    mutex_unlock(&s_time_refs_lock);
+
+    pr_notice_v("Timestamps of adapters %s aligned.\n", READ_ONCE(ts_align) ? "are" : "are not");
+
+    return 0;
+}
+
+static const struct kernel_param_ops S_TS_ALIGN_OPS = {
+    .set = set_ts_align
+    , .get = param_get_bool
+};
+
+module_param_cb(ts_align, &S_TS_ALIGN_OPS, &ts_align, 0644);
+MODULE_PARM_DESC(ts_align, " whether PCANFD_OPT_HWTIMESTAMP_ON timestamps follow the drift-compensated clock model"
+    " like PCANFD_OPT_HWTIMESTAMP_COOKED ones, instead of the nominal tick length"
+    " (default: " __stringify(DEFAULT_TS_ALIGN_FLAG) ")");
+
+void pcan_time_align_add(pcan_time_ref_t *time_ref)
+{
+    mutex_lock(&s_time_refs_lock);
+    list_add_tail(&time_ref->align_node, &s_time_refs);
+    mutex_unlock(&s_time_refs_lock);
+}
+
+void pcan_time_align_remove(pcan_time_ref_t *time_ref)
+{
+    mutex_lock(&s_time_refs_lock);
+    list_del_init(&time_ref->align_node);
+    mutex_unlock(&s_time_refs_lock);
+}
+
+bool pcan_time_align_enabled(void)
+{
+    return READ_ONCE(ts_align);
+}
+
+int pcan_time_align_read_model(pcan_time_ref_t *time_ref, s64 *offset_ns, s64 *rate_ppb)
+{
+    pcan_clock_t clock;
+
+    pcan_time_ref_snapshot(time_ref, &clock);
+    if (0 == clock.tick_count)
+        return -ENODATA;
+
+    *offset_ns = ktime_to_ns(clock.anchor_host) + clock.offset_ns
+        - (s64)mul_u64_u64_shr(clock.anchor_ticks, clock.ns_per_tick_q32, 32);
+    *rate_ppb = clock.freq_ppb;
+
+    return 0;
+}
+
+/*
+ * ================
+ *   CHANGE LOG
+ * ================
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Create.
+ *  02. Turn ts_align off by default, so that PCANFD_OPT_HWTIMESTAMP_ON stays on the nominal line,
+ *      and rename pcan_time_align_estimate() to pcan_time_align_read_model().
+ */
+
@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/*
+ * Driver-wide alignment of timestamps of PCAN-USB adapters.
+ *
+ * Copyright (c) 2026 Man Hung-Coeng <udc577@126.com>
+ * All rights reserved.
+*/
+
+#ifndef __TIME_ALIGN_H__
+#define __TIME_ALIGN_H__
+
+#include <linux/types.h>
+
+struct pcan_time_ref;
+
+/*
+ * Timestamps of all adapters refer to one common host reference, i.e., CLOCK_MONOTONIC:
+ *  - the clock model of each adapter (see packet_codec.h) estimates the offset and rate of its device clock
+ *    against CLOCK_MONOTONIC from its own time references, and its drift-compensated line is what
+ *    skb hwtstamp and PCANFD_OPT_HWTIMESTAMP_COOKED (the default of chardev openers) stamp messages with,
+ *    so that adapters are aligned by default,
+ *  - no adapter is measured against another directly, and a calibration offset of each adapter
+ *    (0 by default), set by user through sysfs attribute ts_offset_ns,
+ *    makes up for what the model can't see, e.g., different USB latencies of adapters
+ *    behind different host controllers or hubs, which is the only cross-adapter correction,
+ *  - the offset is applied to every timestamp converted from device time in every mode but the raw one:
+ *    skb hwtstamp, chardev records (read(), ioctl() and mmap()) and PCANFD_OPT_DRV_CLK_REF,
+ *  - PCANFD_OPT_HWTIMESTAMP_ON timestamps stay on the nominal tick length from the first time reference
+ *    of each adapter, which drifts apart from other adapters by up to 100 us per second,
+ *    unless module parameter ts_align (off by default) makes them follow the drift-compensated line too.
+ * Changes take effect from the next event on, and never on events already stamped.
+ */
+
+/* Joins the list of adapters affected by ts_align, called in probe. */
+void pcan_time_align_add(struct pcan_time_ref *time_ref);
+
+/* Leaves the list above, called on plugout. */
+void pcan_time_align_remove(struct pcan_time_ref *time_ref);
+
+/* Value of module parameter ts_align. */
+bool pcan_time_align_enabled(void);
+
+/*
+ * Reads back the clock model of an adapter as an offset, i.e., host time of device time 0
+ * (calibration offset included), and a frequency error in parts per billion, positive if host clock runs faster.
+ * It's what the model has learned from the time references of the adapter, and no estimation of its own.
+ * Returns -ENODATA if no time reference has been received since bus on.
+ */
+int pcan_time_align_read_model(struct pcan_time_ref *time_ref, s64 *offset_ns, s64 *rate_ppb);
+
+#endif /* #ifndef __TIME_ALIGN_H__ */
+
+/*
+ * ================
+ *   CHANGE LOG
+ * ================
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Create.
+ *  02. Turn ts_align off by default, rename pcan_time_align_estimate() to pcan_time_align_read_model(),
+ *      and state that no offset or rate is estimated across adapters.
+ *  03. Document the drift-compensated line as the default of all timestamp paths but ON and raw ones,
+ *      instead of describing the alignment as something run across adapters.
+ */
+
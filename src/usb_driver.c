@@ -22,6 +22,7 @@
 #include "chardev_ioctl.h"
 #include "chardev_sysfs.h"
 #include "devclass_supplements.h"
+#include "time_align.h"
 #include "evol_kernel.h"
 
 #define PCAN_USB_MSG_TIMEOUT_MS         1000
@@ -128,14 +129,65 @@ int usbdrv_bulk_msg_recv(usb_forwarder_t *forwarder, void *data, int len)
     );
 }
 
+/* Programs the acceptance filter into the adapter, which is left in the specified SJA1000_MODE_*. */
+static int program_acc_filter(usb_forwarder_t *forwarder, u8 mode)
+{
+    u64 filter_11b = READ_ONCE(forwarder->acc_filter_11b);
+    u64 filter_29b = READ_ONCE(forwarder->acc_filter_29b);
+    bool is_open = (PCANFD_ACC_11B_OPEN == filter_11b && PCANFD_ACC_29B_OPEN == filter_29b);
+    int err;
+
+    if (is_open && !forwarder->acc_filter_in_hw)
+        return 0; /* Leave the registers as the firmware sets them. */
+
+    if ((err = pcan_cmd_set_acc_filter(forwarder, filter_11b, filter_29b, mode)) < 0)
+        dev_err_v(&forwarder->usb_dev->dev, "Failed to program acceptance filter: %d\n", err);
+    else
+        forwarder->acc_filter_in_hw = !is_open;
+
+    return err;
+}
+
+int usbdrv_set_acc_filter(usb_forwarder_t *forwarder, bool is_29b, u64 filter)
+{
+    int err = 0;
+
+    /* Also keeps the other half from being changed by another opener in the meantime. */
+    mutex_lock(&forwarder->ctrl_lock);
+
+    if (is_29b)
+        WRITE_ONCE(forwarder->acc_filter_29b, filter);
+    else
+        WRITE_ONCE(forwarder->acc_filter_11b, filter);
+
+    /* NOTE: Frames arriving during the short period in INIT mode are lost. */
+    if (atomic_read(&forwarder->stage) >= PCAN_USB_STAGE_ONE_STARTED)
+        err = program_acc_filter(forwarder, SJA1000_MODE_NORMAL);
+
+    mutex_unlock(&forwarder->ctrl_lock);
+
+    return err;
+}
+
 int usbdrv_reset_bus(usb_forwarder_t *forwarder, unsigned char is_on)
 {
-    int err = pcan_cmd_set_bus(forwarder, is_on);
+    int err;
+
+    /* Never interleaved with programming of the acceptance filter by an opener. */
+    mutex_lock(&forwarder->ctrl_lock);
+
+    if (is_on)
+        program_acc_filter(forwarder, SJA1000_MODE_INIT); /* Not fatal, since software checks it anyway. */
+
+    err = pcan_cmd_set_bus(forwarder, is_on);
 
     pr_notice_v("CAN bus %s, err = %d\n", (is_on ? "ON" : "OFF"), err);
 
     if (err)
-        return err;
+        goto lbl_reset_end;
+
+    /* Shared by netdev and chardev, and updated by decoder afterwards. */
+    WRITE_ONCE(forwarder->can.state, is_on ? CAN_STATE_ERROR_ACTIVE : CAN_STATE_STOPPED);
 
     if (is_on)
     {
@@ -146,6 +198,10 @@ int usbdrv_reset_bus(usb_forwarder_t *forwarder, unsigned char is_on)
     else
         err = pcan_init_sja1000(forwarder);
 
+lbl_reset_end:
+
+    mutex_unlock(&forwarder->ctrl_lock);
+
     return err;
 }
 
@@ -155,11 +211,18 @@ static inline void pcan_dump_mem(const char *prompt, void *ptr, int len)
     print_hex_dump(KERN_INFO, __DRVNAME__ " ", DUMP_PREFIX_NONE, 16, 1, ptr, len, false);
 }
 
+/*
+ * Completions of Rx URBs are given back one by one (from the BH of the host controller),
+ * so the filled buffer kept as the spare one stays intact until decoding below is done.
+ */
 static void usb_read_bulk_callback(struct urb *urb)
 {
-    struct net_device *netdev = (struct net_device *)urb->context;
-    usb_forwarder_t *forwarder = netdev ? (usb_forwarder_t *)netdev_priv(netdev) : NULL;
+    pcan_rx_urb_context_t *ctx = (pcan_rx_urb_context_t *)urb->context;
+    usb_forwarder_t *forwarder = ctx ? ctx->forwarder : NULL;
+    struct net_device *netdev = forwarder ? forwarder->net_dev : NULL;
     int stage = forwarder ? atomic_read(&forwarder->stage) : PCAN_USB_STAGE_DISCONNECTED;
+    u8 *filled_buf = NULL;
+    u32 filled_len = 0;
     int err = 0;
 
     if (unlikely(NULL == forwarder) || stage < PCAN_USB_STAGE_ONE_STARTED)
@@ -183,35 +246,59 @@ static void usb_read_bulk_callback(struct urb *urb)
 
     if (urb->actual_length > 0)
     {
-        err = pcan_decode_and_handle_urb(urb, netdev);
-        if (err)
-        {
-            if (-ENOBUFS != err)
-                netdev_err_ratelimited_v(netdev, "pcan_decode_and_handle_urb() failed, err = %d\n", err);
-
-            /*if (-ENOMEM != err && -ESHUTDOWN != err && -ENOBUFS != err)*/
-            if (-EINVAL == err)
-                pcan_dump_mem("received usb message", urb->transfer_buffer, urb->transfer_buffer_length);
-        }
+        /* Decode it after resubmitting, so that the adapter gets a buffer back as soon as possible. */
+        filled_buf = urb->transfer_buffer;
+        filled_len = urb->actual_length;
+        urb->transfer_buffer = ctx->spare_buf;
+        ctx->spare_buf = filled_buf;
     }
 
 resubmit_urb:
 
     usb_fill_bulk_urb(urb, forwarder->usb_dev, usb_rcvbulkpipe(forwarder->usb_dev, PCAN_USB_EP_MSGIN),
-        urb->transfer_buffer, PCAN_USB_RX_BUFFER_SIZE, usb_read_bulk_callback, netdev);
+        urb->transfer_buffer, PCAN_USB_RX_BUFFER_SIZE, usb_read_bulk_callback, ctx);
 
     usb_anchor_urb(urb, &forwarder->anchor_rx_submitted);
 
     err = usb_submit_urb(urb, GFP_ATOMIC);
-    if (!err)
+    if (err)
+    {
+        usb_unanchor_urb(urb);
+
+        if (-ENODEV == err)
+            netif_device_detach(netdev); /* FIXME: pcan_net_dev_close() ?? */
+        else
+            netdev_err_v(netdev, "failed resubmitting read bulk urb: %d\n", err);
+    }
+
+    if (NULL == filled_buf)
         return;
 
-    usb_unanchor_urb(urb);
+    err = pcan_decode_and_handle_rx_buf(filled_buf, filled_len, netdev);
+    if (err)
+    {
+        if (-ENOBUFS != err)
+            netdev_err_ratelimited_v(netdev, "pcan_decode_and_handle_rx_buf() failed, err = %d\n", err);
 
-    if (-ENODEV == err)
-        netif_device_detach(netdev); /* FIXME: pcan_net_dev_close() ?? */
-    else
-        netdev_err_v(netdev, "failed resubmitting read bulk urb: %d\n", err);
+        /*if (-ENOMEM != err && -ESHUTDOWN != err && -ENOBUFS != err)*/
+        if (-EINVAL == err)
+        {
+            atomic64_inc(&forwarder->char_dev.rx_drops.decode_errors);
+            pcan_dump_mem("received usb message", filled_buf, filled_len);
+        }
+    }
+}
+
+/* NOTE: Call it only when no Rx URB is in flight, i.e., after killing them all. */
+static void free_rx_spare_bufs(usb_forwarder_t *forwarder)
+{
+    int i;
+
+    for (i = 0; i < PCAN_USB_MAX_RX_URBS; ++i)
+    {
+        kfree(forwarder->rx_contexts[i].spare_buf);
+        forwarder->rx_contexts[i].spare_buf = NULL;
+    }
 }
 
 int usbdrv_alloc_urbs(usb_forwarder_t *forwarder)
@@ -224,6 +311,7 @@ int usbdrv_alloc_urbs(usb_forwarder_t *forwarder)
     /* allocate rx urbs and submit them */
     for (i = 0; i < PCAN_USB_MAX_RX_URBS; ++i)
     {
+        pcan_rx_urb_context_t *ctx = forwarder->rx_contexts + i;
         struct urb *urb = usb_alloc_urb(0, GFP_KERNEL);
         u8 *buf = urb ? kmalloc(PCAN_USB_RX_BUFFER_SIZE, GFP_KERNEL) : NULL;
 
@@ -233,15 +321,17 @@ int usbdrv_alloc_urbs(usb_forwarder_t *forwarder)
             break;
         }
 
-        if (NULL == buf)
+        if (NULL == buf || NULL == (ctx->spare_buf = kmalloc(PCAN_USB_RX_BUFFER_SIZE, GFP_KERNEL)))
         {
+            kfree(buf);
             usb_free_urb(urb);
             err = -ENOMEM;
             break;
         }
 
+        ctx->forwarder = forwarder;
         usb_fill_bulk_urb(urb, usb_dev, usb_rcvbulkpipe(usb_dev, PCAN_USB_EP_MSGIN),
-            buf, PCAN_USB_RX_BUFFER_SIZE, usb_read_bulk_callback, forwarder->net_dev);
+            buf, PCAN_USB_RX_BUFFER_SIZE, usb_read_bulk_callback, ctx);
 
         urb->transfer_flags |= URB_FREE_BUFFER; /* ask last usb_free_urb() to also kfree() transfer_buffer */
         usb_anchor_urb(urb, &forwarder->anchor_rx_submitted);
@@ -286,6 +376,8 @@ int usbdrv_alloc_urbs(usb_forwarder_t *forwarder)
         ctx->forwarder = forwarder;
         ctx->urb = urb;
         ctx->echo_index = 0;
+        ctx->frame_count = 0;
+        ctx->buf_len = 0;
 
         /*
          * This just makes an association between urb and buf,
@@ -317,6 +409,7 @@ lbl_free_tx_urbs:
 lbl_free_rx_urbs:
 
     usb_kill_anchored_urbs(&forwarder->anchor_rx_submitted);
+    free_rx_spare_bufs(forwarder);
 
     return err;
 }
@@ -328,6 +421,7 @@ void usbdrv_unlink_all_urbs(usb_forwarder_t *forwarder)
 
     /* free all Rx (submitted) urbs */
     usb_kill_anchored_urbs(&forwarder->anchor_rx_submitted);
+    free_rx_spare_bufs(forwarder);
 
     /* free unsubmitted Tx urbs first */
     for (i = 0; i < MAX_TX_URBS; ++i)
@@ -416,7 +510,7 @@ static int pcan_usb_plugin(struct usb_interface *interface, const struct usb_dev
     if (err)
         return err;
 
-    if (NULL == (netdev = alloc_candev(sizeof(usb_forwarder_t), PCAN_USB_MAX_TX_URBS)))
+    if (NULL == (netdev = alloc_candev(sizeof(usb_forwarder_t), PCAN_USB_MAX_TX_URBS * PCAN_USB_MAX_FRAMES_PER_URB)))
     {
         dev_err_v(&interface->dev, "alloc_candev() failed\n");
         return -ENOMEM;
@@ -428,6 +522,8 @@ static int pcan_usb_plugin(struct usb_interface *interface, const struct usb_dev
 
     forwarder = netdev_priv(netdev);
     memset(((char *)forwarder) + sizeof(struct can_priv), 0, sizeof(*forwarder) - sizeof(struct can_priv));
+    pcan_net_init_rx(netdev); /* NAPI instance is deleted by free_candev(). */
+    pcan_time_ref_init(&forwarder->time_ref);
     if ((err = alloc_subitems(forwarder)) < 0)
     {
         goto lbl_release_res;
@@ -439,6 +535,10 @@ static int pcan_usb_plugin(struct usb_interface *interface, const struct usb_dev
     atomic_set(&forwarder->pending_ops, 0);
     INIT_DELAYED_WORK(&forwarder->destroy_work, destroy_usb_forwarder);
     evol_setup_timer(&forwarder->restart_timer, network_up_callback, forwarder);
+    forwarder->acc_filter_11b = PCANFD_ACC_11B_OPEN;
+    forwarder->acc_filter_29b = PCANFD_ACC_29B_OPEN;
+    forwarder->acc_filter_in_hw = false;
+    mutex_init(&forwarder->ctrl_lock);
 
     forwarder->can.clock = *get_fixed_can_clock();
     forwarder->can.bittiming_const = get_can_bittiming_const();
@@ -479,6 +579,9 @@ static int pcan_usb_plugin(struct usb_interface *interface, const struct usb_dev
     if (net_up)
         pcan_net_dev_open(netdev);
 
+    pcan_time_align_add(&forwarder->time_ref);
+    pcan_ptp_register(forwarder, &interface->dev);
+
     usb_set_intfdata(interface, forwarder);
 
     dev_notice_v(&interface->dev, "New PCAN-USB device plugged in\n");
@@ -508,46 +611,23 @@ lbl_release_res:
 
 static int alloc_subitems(usb_forwarder_t *forwarder)
 {
-    pcan_chardev_t *chrdev = &forwarder->char_dev;
-
-    if (NULL == (chrdev->ioctl_rxmsgs = kzalloc(SIZE_OF_PCANFD_IOCTL_MSGS(PCAN_CHRDEV_MAX_RX_BUF_COUNT), GFP_KERNEL)))
-    {
-        pr_err_v("kzalloc() for char_dev.ioctl_rxmsgs failed\n");
-        goto lbl_failed_exit;
-    }
-
     if (NULL == (forwarder->cmd_buf = kmalloc(PCAN_USB_MAX_CMD_LEN, GFP_KERNEL)))
     {
         pr_err_v("kmalloc() for cmd_buf failed\n");
-        goto lbl_free_ioctl_rxmsgs;
+
+        return -ENOMEM;
     }
 
     return 0;
-
-lbl_free_ioctl_rxmsgs:
-
-    kfree(chrdev->ioctl_rxmsgs);
-
-lbl_failed_exit:
-
-    return -ENOMEM;
 }
 
 static void free_subitems(usb_forwarder_t *forwarder)
 {
-    pcan_chardev_t *chrdev = &forwarder->char_dev;
-
     if (NULL != forwarder->cmd_buf)
     {
         kfree(forwarder->cmd_buf);
         forwarder->cmd_buf = NULL;
     }
-
-    if (NULL != chrdev->ioctl_rxmsgs)
-    {
-        kfree(chrdev->ioctl_rxmsgs);
-        chrdev->ioctl_rxmsgs = NULL;
-    }
 }
 
 static void destroy_usb_forwarder(struct work_struct *work_info)
@@ -564,6 +644,7 @@ static void destroy_usb_forwarder(struct work_struct *work_info)
         goto lbl_resched;
 
     free_subitems(forwarder);
+    skb_queue_purge(&forwarder->net_rx_queue); /* In case some URB completed in the middle of closing netdev. */
     pr_notice_v("PCAN-USB[%s|%s] destroyed\n", netdev_name(forwarder->net_dev), dev_name(forwarder->char_dev.device));
     free_candev(forwarder->net_dev);
 
@@ -585,6 +666,8 @@ static void pcan_usb_plugout(struct usb_interface *interface)
     if (NULL != forwarder)
     {
         atomic_set(&forwarder->stage, PCAN_USB_STAGE_DISCONNECTED); /* atomic_dec(&forwarder->stage); */
+        pcan_ptp_unregister(forwarder);
+        pcan_time_align_remove(&forwarder->time_ref);
         sysfs_remove_files(&forwarder->char_dev.device->kobj, pcan_device_attributes());
         pcan_chardev_finalize(&forwarder->char_dev);
         unregister_candev(forwarder->net_dev);
@@ -667,5 +750,22 @@ static void pcan_usb_plugout(struct usb_interface *interface)
  *
  * >>> 2023-12-18, Man Hung-Coeng <udc577@126.com>:
  *  01. Add sysfs attributes.
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Decouple the size of ioctl_rxmsgs from the capacity of chardev Rx buffer.
+ *  02. Move ioctl_rxmsgs to each reader of chardev.
+ *  03. Reserve an echo skb slot for every frame packed in netdev Tx URBs.
+ *  04. Count malformed Rx USB messages as Rx drops.
+ *  05. Program the acceptance filter into the adapter before turning bus on,
+ *      and add usbdrv_set_acc_filter().
+ *  06. Update bus state in usbdrv_reset_bus() for both netdev and chardev.
+ *  07. Set up NAPI of netdev Rx in probe, and purge the pending skbs on destroying.
+ *  08. Resubmit an Rx URB with a spare buffer before decoding the filled one,
+ *      to shorten the time the adapter is left with fewer buffers to fill.
+ *  09. Initialize the clock model in probe.
+ *  10. Register the PTP hardware clock in probe, and unregister it on plugout.
+ *  11. Join the time alignment service in probe, and leave it on plugout.
+ *  12. Serialize setting of the acceptance filter and bus on/off with a mutex,
+ *      and set one half of the acceptance filter at a time in usbdrv_set_acc_filter().
  */
 
@@ -17,6 +17,7 @@
 
 #include "chardev_operations.h" /* struct pcan_chardev */
 #include "packet_codec.h" /* struct pcan_time_ref */
+#include "ptp_operations.h" /* struct pcan_ptp */
 
 #define PCAN_USB_STAGE_DISCONNECTED         0
 #define PCAN_USB_STAGE_CONNECTED            1
@@ -33,6 +34,9 @@
 #define PCAN_USB_RX_BUFFER_SIZE             64
 #define PCAN_USB_TX_BUFFER_SIZE             64
 
+/* A Tx buffer holds a 2-byte header, records of 11 bytes at most for standard frames, and a trailing byte. */
+#define PCAN_USB_MAX_FRAMES_PER_URB         ((PCAN_USB_TX_BUFFER_SIZE - 2 - 1) / (1 + 2 + CAN_MAX_DLEN))
+
 #define PCAN_USB_EP_CMDOUT                  1
 #define PCAN_USB_EP_CMDIN                   (PCAN_USB_EP_CMDOUT | USB_DIR_IN)
 #define PCAN_USB_EP_MSGOUT                  2
@@ -44,9 +48,20 @@ typedef struct pcan_tx_urb_context
 {
     struct urb *urb;
     struct usb_forwarder *forwarder;
-    u32 echo_index;
+    u32 echo_index; /* index of context plus 1, or 0 if idle */
+    u8 frame_count; /* count of frames packed in this URB */
+    size_t buf_len; /* bytes of transfer buffer used by the header and frames */
 } pcan_tx_urb_context_t;
 
+typedef struct pcan_rx_urb_context
+{
+    struct usb_forwarder *forwarder;
+    u8 *spare_buf; /* swapped with the filled transfer buffer, so that the URB is resubmitted before decoding */
+} pcan_rx_urb_context_t;
+
+/* Echo skb slots of a netdev Tx context, whose echo_index must be non-zero. */
+#define PCAN_USB_ECHO_SLOT(ctx, i)          (((ctx)->echo_index - 1) * PCAN_USB_MAX_FRAMES_PER_URB + (i))
+
 typedef struct usb_forwarder
 {
     struct can_priv can; /* NOTE: MUST be 1st field, see implementation of alloc_candev(). */
@@ -56,14 +71,27 @@ typedef struct usb_forwarder
     u8 *cmd_buf;
     struct usb_anchor anchor_rx_submitted;
     struct usb_anchor anchor_tx_submitted;
+    pcan_rx_urb_context_t rx_contexts[PCAN_USB_MAX_RX_URBS];
     pcan_tx_urb_context_t tx_contexts[PCAN_USB_MAX_TX_URBS * 2]; /* One half for netdev, the other half for chardev. */
+    pcan_tx_urb_context_t *net_tx_filling; /* netdev Tx context being filled with frames, not submitted yet */
     atomic_t active_tx_urbs;
     atomic_t shared_tx_counter; /* Shared by netdev and chardev. */
     atomic_t stage; /* 0: disconnected, 1: connected, 2 and above: netdev or/and chardev activated. */
     atomic_t pending_ops; /* Pending operations: For synchronized commands and chardev operations. */
     struct timer_list restart_timer;
     struct pcan_time_ref time_ref;
+    struct pcan_ptp ptp; /* PHC reading device time of time_ref */
     struct timespec64 bus_up_time; /* The time point when CAN bus is brought up. */
+    u64 acc_filter_11b; /* value of PCANFD_OPT_ACC_FILTER_11B */
+    u64 acc_filter_29b; /* value of PCANFD_OPT_ACC_FILTER_29B */
+    bool acc_filter_in_hw; /* whether SJA1000 acceptance registers have been changed */
+    struct mutex ctrl_lock; /* serializes acc_filter_* updates and programming of SJA1000 by them and bus on/off */
+    struct napi_struct napi; /* delivers net_rx_queue to the stack in batches */
+    struct sk_buff_head net_rx_queue; /* skbs decoded for netdev, each URB of which sorted by hardware timestamp */
+#ifdef INNER_TEST
+    u64 decode_cycles; /* cycles spent in decoding Rx URBs, reset every 65536 frames */
+    u64 decoded_frames;
+#endif
     struct delayed_work destroy_work;
 } usb_forwarder_t;
 
@@ -77,6 +105,23 @@ int usbdrv_bulk_msg_recv(usb_forwarder_t *forwarder, void *data, int len);
 
 int usbdrv_reset_bus(usb_forwarder_t *forwarder, unsigned char is_on);
 
+/*
+ * Sets the 11-bit or 29-bit half of the acceptance filter, which is checked by software at once,
+ * and programmed into the adapter at once if bus is on, or the next time bus is turned on otherwise.
+ * Must be called in process context.
+ */
+int usbdrv_set_acc_filter(usb_forwarder_t *forwarder, bool is_29b, u64 filter);
+
+/* Exact check of the acceptance filter, for what the adapter lets through but should not. */
+static inline bool usbdrv_acc_filter_pass(const usb_forwarder_t *forwarder, canid_t can_id)
+{
+    bool is_ext = (can_id & CAN_EFF_FLAG);
+    u64 filter = is_ext ? READ_ONCE(forwarder->acc_filter_29b) : READ_ONCE(forwarder->acc_filter_11b);
+    u32 care = ~(u32)filter & (is_ext ? CAN_EFF_MASK : CAN_SFF_MASK);
+
+    return (can_id & CAN_ERR_FLAG) || 0 == ((can_id ^ (u32)(filter >> 32)) & care);
+}
+
 int usbdrv_alloc_urbs(usb_forwarder_t *forwarder);
 
 void usbdrv_unlink_all_urbs(usb_forwarder_t *forwarder);
@@ -137,5 +182,16 @@ static inline void usbdrv_default_completion(struct urb *urb)
  *
  * >>> 2023-12-23, Man Hung-Coeng <udc577@126.com>:
  *  01. Add a new field "bus_up_time" to struct usb_forwarder.
+ *
+ * >>> 2026-10-16, Man Hung-Coeng <udc577@126.com>:
+ *  01. Pack up to PCAN_USB_MAX_FRAMES_PER_URB frames into a Tx URB,
+ *      and add fields tracking them to struct pcan_tx_urb_context and struct usb_forwarder.
+ *  02. Add fields and functions of the acceptance filter.
+ *  03. Add counters of decoding cost (INNER_TEST only).
+ *  04. Add a NAPI instance and a queue of skbs for netdev Rx.
+ *  05. Add a spare buffer for each Rx URB.
+ *  06. Add a new field ptp to struct usb_forwarder.
+ *  07. Add a mutex serializing the acceptance filter and bus on/off,
+ *      and set one half of the acceptance filter at a time in usbdrv_set_acc_filter().
  */
 